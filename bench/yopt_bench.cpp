@@ -0,0 +1,448 @@
+/// yopt parsing and lookup benchmarks
+/// JSON report: yopt_bench --benchmark_out=yopt_bench.json --benchmark_out_format=json
+
+#include <yopt.h>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <codecvt>
+#include <cstddef>
+#include <cstdlib>
+#include <locale>
+#include <iterator>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#if __has_include(<iconv.h>)
+#include <iconv.h>
+#define YOPT_BENCH_ICONV 1
+#endif
+
+/// global allocation counter, reported per iteration as the "allocs" counter
+namespace {
+	std::atomic<std::size_t> allocation_count{0};
+
+	/// Out of line so g++ does not pair an inlined malloc with the free of a delete expression
+	/// (-Wmismatched-new-delete). Over-aligned requests are counted as well.
+	[[gnu::noinline]] void * counted_alloc(std::size_t size, std::size_t alignment = 0) {
+		allocation_count.fetch_add(1, std::memory_order_relaxed);
+		size = size ? size : 1;
+		void * p;
+		if (alignment == 0) {
+			p = std::malloc(size);
+		} else {
+#if defined _WIN32
+			p = _aligned_malloc(size, alignment);
+#else
+			p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+#endif
+		}
+		if (p == nullptr)
+			throw std::bad_alloc{};
+		return p;
+	}
+
+	[[gnu::noinline]] void counted_free(void * p, bool aligned = false) noexcept {
+#if defined _WIN32
+		if (aligned) {
+			_aligned_free(p);
+			return;
+		}
+#else
+		(void) aligned;
+#endif
+		std::free(p);
+	}
+}
+
+void * operator new(std::size_t size) {
+	return counted_alloc(size);
+}
+
+void * operator new[](std::size_t size) {
+	return counted_alloc(size);
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment) {
+	return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment) {
+	return counted_alloc(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void * p) noexcept {
+	counted_free(p);
+}
+
+void operator delete[](void * p) noexcept {
+	counted_free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept {
+	counted_free(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept {
+	counted_free(p);
+}
+
+void operator delete(void * p, std::align_val_t) noexcept {
+	counted_free(p, true);
+}
+
+void operator delete[](void * p, std::align_val_t) noexcept {
+	counted_free(p, true);
+}
+
+void operator delete(void * p, std::size_t, std::align_val_t) noexcept {
+	counted_free(p, true);
+}
+
+void operator delete[](void * p, std::size_t, std::align_val_t) noexcept {
+	counted_free(p, true);
+}
+
+namespace {
+
+/// counts allocations made while the benchmark loop runs
+class allocation_scope {
+public:
+	explicit allocation_scope(benchmark::State & state) : state(state), start(allocation_count.load()) {}
+
+	~allocation_scope() {
+		const auto count = allocation_count.load() - start;
+		state.counters["allocs"] = benchmark::Counter(static_cast<double>(count), benchmark::Counter::kAvgIterations);
+	}
+
+private:
+	benchmark::State & state;
+	std::size_t start;
+};
+
+constexpr char realistic_cmd[] =
+	"--threads=8 --verbose --log-level=info --config=\"/etc/yopt/service.conf\" "
+	"--port=8080 --timeout=2.5 --retries=3 --dry-run=no input-a.txt input-b.txt";
+
+const char * const realistic_argv[] = {
+	"service", "--threads=8", "--verbose", "--log-level=info", "--config=/etc/yopt/service configuration.conf",
+	"--port=8080", "--timeout=2.5", "--retries=3", "--dry-run=no", "input-a.txt", "input-b.txt"
+};
+
+/// generated file list style command line of at least size chars
+template <typename CharT>
+std::basic_string<CharT> synthetic_cmd(std::size_t size) {
+	std::string s;
+	for (std::size_t i = 0; s.size() < size; ++i) {
+		s += "--key" + std::to_string(i) + "=value" + std::to_string(i) + " /data/input/file-" + std::to_string(i) + ".bin ";
+	}
+	s.resize(size);
+	return {s.begin(), s.end()};
+}
+
+std::vector<std::string> synthetic_keys(std::size_t count) {
+	std::vector<std::string> keys;
+	for (std::size_t i = 0; i < count; ++i) {
+		keys.push_back("key" + std::to_string(i));
+	}
+	return keys;
+}
+
+template <typename CharT>
+std::basic_string<CharT> widen(std::string_view s) {
+	return {s.begin(), s.end()};
+}
+
+/// -- parsing --
+
+template <typename CharT>
+void BM_parse_realistic(benchmark::State & state) {
+	const auto cmd = widen<CharT>(realistic_cmd);
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		yopt::options o{cmd.c_str()};
+		benchmark::DoNotOptimize(o);
+	}
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * cmd.size() * sizeof(CharT)));
+}
+BENCHMARK_TEMPLATE(BM_parse_realistic, char);
+BENCHMARK_TEMPLATE(BM_parse_realistic, wchar_t);
+
+void BM_parse_argv(benchmark::State & state) {
+	constexpr int argc = static_cast<int>(std::size(realistic_argv));
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		yopt::options o{argc, realistic_argv};
+		benchmark::DoNotOptimize(o);
+	}
+}
+BENCHMARK(BM_parse_argv);
+
+/// NUL terminated path, capped at yopt::max_length
+template <typename CharT>
+void BM_parse_cstr(benchmark::State & state) {
+	const auto cmd = synthetic_cmd<CharT>(static_cast<std::size_t>(state.range(0)));
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		yopt::options o{cmd.c_str()};
+		benchmark::DoNotOptimize(o);
+	}
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * cmd.size() * sizeof(CharT)));
+}
+BENCHMARK_TEMPLATE(BM_parse_cstr, char)->Arg(1 << 10)->Arg(4000);
+BENCHMARK_TEMPLATE(BM_parse_cstr, wchar_t)->Arg(1 << 10)->Arg(4000);
+
+/// length aware path, uncapped
+template <typename CharT>
+void BM_parse_view(benchmark::State & state) {
+	const auto cmd = synthetic_cmd<CharT>(static_cast<std::size_t>(state.range(0)));
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		yopt::options<CharT> o{std::basic_string_view<CharT>{cmd}};
+		benchmark::DoNotOptimize(o);
+	}
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * cmd.size() * sizeof(CharT)));
+}
+BENCHMARK_TEMPLATE(BM_parse_view, char)->Arg(1 << 10)->Arg(4000)->Arg(1 << 16)->Arg(1 << 20);
+BENCHMARK_TEMPLATE(BM_parse_view, wchar_t)->Arg(1 << 10)->Arg(1 << 16)->Arg(1 << 20);
+
+/// SAX style parse, nothing stored
+void BM_parse_visitor(benchmark::State & state) {
+	struct counter {
+		std::size_t n = 0;
+		void on_option(std::string_view key, std::string_view value) {
+			n += key.size() + value.size();
+		}
+		void on_arg(std::string_view value) {
+			n += value.size();
+		}
+	};
+	const auto cmd = synthetic_cmd<char>(static_cast<std::size_t>(state.range(0)));
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		counter c;
+		yopt::parse(std::string_view{cmd}, c);
+		benchmark::DoNotOptimize(c.n);
+	}
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * cmd.size()));
+}
+BENCHMARK(BM_parse_visitor)->Arg(1 << 10)->Arg(1 << 16);
+
+void BM_parse_pmr(benchmark::State & state) {
+	const auto cmd = synthetic_cmd<char>(static_cast<std::size_t>(state.range(0)));
+	std::vector<std::byte> buffer(1 << 20);
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size()};
+		yopt::pmr::options<char> o{std::string_view{cmd}, &arena};
+		benchmark::DoNotOptimize(o);
+	}
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * cmd.size()));
+}
+BENCHMARK(BM_parse_pmr)->Arg(1 << 10)->Arg(1 << 16);
+
+/// stored job specs re-parsed in bulk, Arg is the thread count
+void BM_parse_batch(benchmark::State & state) {
+	std::vector<std::string> storage;
+	for (std::size_t i = 0; i < 10000; ++i) {
+		storage.push_back(std::string{realistic_cmd} + " --job-id=" + std::to_string(i));
+	}
+	std::vector<const char *> lines;
+	for (const auto & l : storage) {
+		lines.push_back(l.c_str());
+	}
+	const auto threads = static_cast<unsigned>(state.range(0));
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		auto b = yopt::parse_batch<char>(lines, threads);
+		benchmark::DoNotOptimize(b);
+	}
+	state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * lines.size()));
+}
+BENCHMARK(BM_parse_batch)->RangeMultiplier(2)->Range(1, 64)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/// -- lookup --
+
+constexpr std::size_t lookup_keys = 256;
+
+template <typename CharT>
+struct lookup_fixture {
+	std::basic_string<CharT> cmd;
+	yopt::options<CharT> o;
+	std::vector<std::string> keys;
+
+	lookup_fixture() : cmd(make_cmd()), o(std::basic_string_view<CharT>{cmd}), keys(synthetic_keys(lookup_keys)) {}
+
+	static std::basic_string<CharT> make_cmd() {
+		std::string s;
+		for (std::size_t i = 0; i < lookup_keys; ++i) {
+			s += "--key" + std::to_string(i) + "=" + std::to_string(i * 7) + " ";
+		}
+		return widen<CharT>(s);
+	}
+};
+
+template <typename CharT, typename F>
+void run_lookup(benchmark::State & state, F && f) {
+	const lookup_fixture<CharT> fx;
+	std::size_t i = 0;
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(f(fx.o, fx.keys[i]));
+		i = (i + 1) % lookup_keys;
+	}
+}
+
+template <typename CharT>
+void BM_has_opt(benchmark::State & state) {
+	run_lookup<CharT>(state, [](const auto & o, const std::string & k) { return o.has_opt(k); });
+}
+BENCHMARK_TEMPLATE(BM_has_opt, char);
+BENCHMARK_TEMPLATE(BM_has_opt, wchar_t);
+
+template <typename CharT>
+void BM_get_int(benchmark::State & state) {
+	run_lookup<CharT>(state, [](const auto & o, const std::string & k) { return o.get_int(k); });
+}
+BENCHMARK_TEMPLATE(BM_get_int, char);
+BENCHMARK_TEMPLATE(BM_get_int, wchar_t);
+
+template <typename CharT>
+void BM_get_number_double(benchmark::State & state) {
+	run_lookup<CharT>(state, [](const auto & o, const std::string & k) { return o.template get_number<double>(k); });
+}
+BENCHMARK_TEMPLATE(BM_get_number_double, char);
+BENCHMARK_TEMPLATE(BM_get_number_double, wchar_t);
+
+template <typename CharT>
+void BM_get_bool(benchmark::State & state) {
+	/// synthetic values are numbers, use a dedicated command line with boolean tokens
+	const auto cmd = widen<CharT>("--a --b=yes --c=0 --d=TRUE --e=n --f=1 --g=F --h=no");
+	const yopt::options<CharT> o{std::basic_string_view<CharT>{cmd}};
+	const char * const keys[] = {"a", "b", "c", "d", "e", "f", "g", "h"};
+	std::size_t i = 0;
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(o.get_bool(keys[i]));
+		i = (i + 1) % std::size(keys);
+	}
+}
+BENCHMARK_TEMPLATE(BM_get_bool, char);
+BENCHMARK_TEMPLATE(BM_get_bool, wchar_t);
+
+template <typename CharT>
+void BM_get_string(benchmark::State & state) {
+	run_lookup<CharT>(state, [](const auto & o, const std::string & k) { return o.get_string(k); });
+}
+BENCHMARK_TEMPLATE(BM_get_string, char);
+BENCHMARK_TEMPLATE(BM_get_string, wchar_t);
+
+/// baseline: the std::map store options used before the flat index
+void BM_lookup_std_map_baseline(benchmark::State & state) {
+	const lookup_fixture<char> fx;
+	std::map<std::string_view, std::string_view> opts;
+	for (std::size_t i = 0; i < lookup_keys; ++i) {
+		opts[fx.keys[i]] = fx.o.get_native_string(fx.keys[i]).value();
+	}
+	std::size_t i = 0;
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(opts.find(fx.keys[i]) != std::end(opts));
+		i = (i + 1) % lookup_keys;
+	}
+}
+BENCHMARK(BM_lookup_std_map_baseline);
+
+/// baseline: the std::map<wstring_view> store with a temporary std::wstring key per lookup
+void BM_lookup_std_map_wchar_baseline(benchmark::State & state) {
+	const lookup_fixture<wchar_t> fx;
+	std::vector<std::wstring> wide_keys;
+	for (const auto & k : fx.keys) {
+		wide_keys.push_back(widen<wchar_t>(k));
+	}
+	std::map<std::wstring_view, std::wstring_view> opts;
+	for (const auto & k : wide_keys) {
+		opts[k] = {};
+	}
+	std::size_t i = 0;
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		const std::string & key = fx.keys[i];
+		const std::wstring wkey{std::begin(key), std::end(key)};
+		benchmark::DoNotOptimize(opts.find(wkey) != std::end(opts));
+		i = (i + 1) % lookup_keys;
+	}
+}
+BENCHMARK(BM_lookup_std_map_wchar_baseline);
+
+/// -- wide to UTF-8 transcoding --
+
+std::wstring transcode_input(std::size_t size, bool ascii) {
+	std::wstring s;
+	for (std::size_t i = 0; s.size() < size; ++i) {
+		s += L"/data/input/file-";
+		s += ascii ? L"plain" : L"été-€";
+	}
+	s.resize(size);
+	return s;
+}
+
+void BM_wstrtoutf8_yopt(benchmark::State & state) {
+	const auto s = transcode_input(static_cast<std::size_t>(state.range(0)), state.range(1) != 0);
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(yopt::detail::wstrtoutf8(s));
+	}
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * s.size() * sizeof(wchar_t)));
+}
+BENCHMARK(BM_wstrtoutf8_yopt)->ArgsProduct({{64, 4096}, {1, 0}})->ArgNames({"size", "ascii"});
+
+#if defined __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+#endif
+void BM_wstrtoutf8_wstring_convert(benchmark::State & state) {
+	const auto s = transcode_input(static_cast<std::size_t>(state.range(0)), state.range(1) != 0);
+	std::wstring_convert<std::codecvt_utf8<wchar_t>> convert;
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(convert.to_bytes(s.data(), s.data() + s.size()));
+	}
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * s.size() * sizeof(wchar_t)));
+}
+BENCHMARK(BM_wstrtoutf8_wstring_convert)->ArgsProduct({{64, 4096}, {1, 0}})->ArgNames({"size", "ascii"});
+#if defined __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+#if defined YOPT_BENCH_ICONV
+void BM_wstrtoutf8_iconv(benchmark::State & state) {
+	const auto s = transcode_input(static_cast<std::size_t>(state.range(0)), state.range(1) != 0);
+	const iconv_t cd = ::iconv_open("UTF-8", "WCHAR_T");
+	if (cd == reinterpret_cast<iconv_t>(-1)) {
+		state.SkipWithError("iconv_open failed");
+		return;
+	}
+	allocation_scope allocs{state};
+	for (auto _ : state) {
+		std::string out(s.size() * 4, '\0');
+		auto * in = const_cast<char *>(reinterpret_cast<const char *>(s.data()));
+		std::size_t in_left = s.size() * sizeof(wchar_t);
+		char * o = out.data();
+		std::size_t out_left = out.size();
+		::iconv(cd, &in, &in_left, &o, &out_left);
+		out.resize(out.size() - out_left);
+		benchmark::DoNotOptimize(out);
+	}
+	::iconv_close(cd);
+	state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * s.size() * sizeof(wchar_t)));
+}
+BENCHMARK(BM_wstrtoutf8_iconv)->ArgsProduct({{64, 4096}, {1, 0}})->ArgNames({"size", "ascii"});
+#endif
+
+} //ns
+
+BENCHMARK_MAIN();
@@ -3,329 +3,2865 @@
 
 #if defined _WIN32
 #include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+extern char ** environ;
 #endif
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <string_view>
-#include <map>
-#include <unordered_set>
 #include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <array>
+#include <cstdint>
 #include <charconv>
 #include <optional>
+#include <span>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <utility>
 
 /// configuration
 #define YOPT_CMD_MAX_LENGTH 4096
+/// nesting limit of @file response files in argv, 0 disables response files
+#ifndef YOPT_RESPONSE_FILE_MAX_DEPTH
+#define YOPT_RESPONSE_FILE_MAX_DEPTH 16
+#endif
+/// define YOPT_NO_SIMD to always use the scalar command line scanner
+
+#if !defined YOPT_NO_SIMD
+#if defined __AVX2__
+#define YOPT_AVX2 1
+#include <immintrin.h>
+#endif
+#if defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+#define YOPT_SSE2 1
+#include <emmintrin.h>
+#endif
+#endif
+
+namespace yopt {
+
+inline constexpr size_t max_length = YOPT_CMD_MAX_LENGTH;
+inline constexpr size_t response_file_max_depth = YOPT_RESPONSE_FILE_MAX_DEPTH;
+
+/// Tokens recognized by options::get_bool.
+/// Derive and redeclare true_values/false_values to extend, every token must be 1..7 ASCII chars.
+struct bool_vocabulary {
+	static constexpr std::string_view true_values[] = {"TRUE", "true", "T", "YES", "yes", "Y", "y", "1"};
+	static constexpr std::string_view false_values[] = {"FALSE", "false", "F", "NO", "no", "N", "n", "0"};
+};
+
+namespace detail {
+	inline std::optional<std::string> wstrtoutf8(const std::wstring_view & s);
+	template <typename Out>
+	bool utf8towstr(std::string_view s, Out & out);
+
+	/// Three-way compare of a native key against a narrow lookup key.
+	/// Each narrow char is widened like std::basic_string<CharT>{begin, end} would do, without allocating.
+	template <typename CharT>
+	constexpr int compare_key(std::basic_string_view<CharT> native, std::string_view key) noexcept {
+		if constexpr (std::is_same_v<CharT, char>) {
+			return native.compare(key);
+		} else {
+			using traits = std::char_traits<CharT>;
+			const auto n = std::min(native.size(), key.size());
+			for (size_t i = 0; i < n; ++i) {
+				const auto c = static_cast<CharT>(key[i]);
+				if (traits::lt(native[i], c))
+					return -1;
+				if (traits::lt(c, native[i]))
+					return 1;
+			}
+			if (native.size() == key.size())
+				return 0;
+			return native.size() < key.size() ? -1 : 1;
+		}
+	}
+
+	/// Packs a short ASCII token and its length into a single word, 0 if the token does not fit.
+	template <typename CharT>
+	constexpr std::uint64_t pack_token(std::basic_string_view<CharT> s) noexcept {
+		if (s.empty() || s.size() > 7)
+			return 0;
+		std::uint64_t w = s.size();
+		for (size_t i = 0; i < s.size(); ++i) {
+			const auto c = static_cast<std::make_unsigned_t<CharT>>(s[i]);
+			if (c == 0 || c > 0x7f)
+				return 0;
+			w |= std::uint64_t{c} << (8 * (i + 1));
+		}
+		return w;
+	}
+
+	/// Compile time boolean token tables, matching is a handful of word compares without allocation or hashing.
+	template <typename Vocabulary>
+	struct bool_recognizer {
+		template <size_t N>
+		static constexpr std::array<std::uint64_t, N> pack_all(const std::string_view (& values)[N]) {
+			std::array<std::uint64_t, N> words{};
+			for (size_t i = 0; i < N; ++i) {
+				words[i] = pack_token(values[i]);
+				if (words[i] == 0)
+					throw std::invalid_argument("boolean token must be 1..7 ASCII chars"); /// not a constant expression - compile error
+			}
+			return words;
+		}
+
+		static constexpr auto true_words = pack_all(Vocabulary::true_values);
+		static constexpr auto false_words = pack_all(Vocabulary::false_values);
+
+		template <typename CharT>
+		static constexpr std::optional<bool> match(std::basic_string_view<CharT> s) noexcept {
+			const auto w = pack_token(s);
+			if (w == 0)
+				return std::nullopt;
+			for (const auto t : true_words) {
+				if (t == w)
+					return true;
+			}
+			for (const auto f : false_words) {
+				if (f == w)
+					return false;
+			}
+			return std::nullopt;
+		}
+	};
+
+	/// chars that may change the parser state: whitespace, dash, equal sign and quote
+	template <typename CharT>
+	constexpr bool is_structural(CharT c) noexcept {
+		return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') || (c == '-') || (c == '=') || (c == '"');
+	}
+
+	template <typename CharT>
+	inline const CharT * find_structural_scalar(const CharT * p, const CharT * end) noexcept {
+		while (p < end && !is_structural(*p))
+			++p;
+		return p;
+	}
+
+#if defined YOPT_SSE2 || defined YOPT_AVX2
+	inline unsigned count_trailing_zeros(std::uint32_t bits) noexcept {
+#if defined _MSC_VER
+		unsigned long index;
+		_BitScanForward(&index, bits);
+		return static_cast<unsigned>(index);
+#else
+		return static_cast<unsigned>(__builtin_ctz(bits));
+#endif
+	}
+#endif
+
+#if defined YOPT_AVX2
+	/// bytes classified at once by structural_bits
+	constexpr std::ptrdiff_t structural_block = 32;
+
+	/// bit i is set if p[i] is structural, for the 32 bytes at p
+	inline std::uint32_t structural_bits(const char * p) noexcept {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		__m256i m = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t')));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('-')));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('=')));
+		m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')));
+		return static_cast<std::uint32_t>(_mm256_movemask_epi8(m));
+	}
+#elif defined YOPT_SSE2
+	/// bytes classified at once by structural_bits
+	constexpr std::ptrdiff_t structural_block = 16;
+
+	/// bit i is set if p[i] is structural, for the 16 bytes at p
+	inline std::uint32_t structural_bits(const char * p) noexcept {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i m = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\t')));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('-')));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('=')));
+		m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('"')));
+		return static_cast<std::uint32_t>(_mm_movemask_epi8(m));
+	}
+#endif
+
+	/// Forward only scanner for the structural chars of one buffer.
+	/// Narrow input is classified a block of 32 (AVX2) or 16 (SSE2) bytes at a time. The mask of the current
+	/// block is kept and its bits are cleared as the scan passes them, the next block is classified only once
+	/// the mask runs empty. Wide input, tails shorter than a block and Vector == false are scanned per char.
+	template <typename CharT, bool Vector = true>
+	struct structural_cursor {
+		/// start and end of the classified block, both at the last reload point while there is none
+		const CharT * base;
+		const CharT * limit;
+		/// structural chars of [base, limit) not yet passed
+		std::uint32_t bits = 0;
+
+		explicit structural_cursor(const CharT * s) noexcept : base(s), limit(s) {}
+
+		/// First structural char in [p, end) or end, p must not go back between calls.
+		const CharT * next(const CharT * p, const CharT * end) noexcept {
+#if defined YOPT_SSE2 || defined YOPT_AVX2
+			if constexpr (Vector && std::is_same_v<CharT, char>) {
+				if (p < limit) {
+					bits &= ~std::uint32_t{0} << (p - base);
+				} else if (end - p >= structural_block) {
+					base = p;
+					limit = p + structural_block;
+					bits = structural_bits(p);
+				} else {
+					return find_structural_scalar(p, end);
+				}
+				while (bits == 0) {
+					if (end - limit < structural_block)
+						return find_structural_scalar(limit, end);
+					base = limit;
+					limit += structural_block;
+					bits = structural_bits(base);
+				}
+				return base + count_trailing_zeros(bits);
+			}
+#endif
+			return find_structural_scalar(p, end);
+		}
+	};
+
+	/// First structural char in [p, end) or end, a one shot structural_cursor.
+	template <typename CharT>
+	inline const CharT * find_structural(const CharT * p, const CharT * end) noexcept {
+		return structural_cursor<CharT>{p}.next(p, end);
+	}
+
+	/// First c in [p, end) or end, narrow input is compared 32 (AVX2) or 16 (SSE2) bytes at a time.
+	template <typename CharT>
+	inline const CharT * find_char(const CharT * p, const CharT * end, CharT c) noexcept {
+		if constexpr (std::is_same_v<CharT, char>) {
+#if defined YOPT_AVX2
+			const __m256i c32 = _mm256_set1_epi8(c);
+			while (end - p >= 32) {
+				const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+				const auto bits = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, c32)));
+				if (bits != 0)
+					return p + count_trailing_zeros(bits);
+				p += 32;
+			}
+#endif
+#if defined YOPT_SSE2
+			const __m128i c16 = _mm_set1_epi8(c);
+			while (end - p >= 16) {
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+				const auto bits = static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, c16)));
+				if (bits != 0)
+					return p + count_trailing_zeros(bits);
+				p += 16;
+			}
+#endif
+		}
+		while (p < end && *p != c)
+			++p;
+		return p;
+	}
+
+	enum class parse_state { none, key_prefix, long_key_prefix, key, value, quoted_value };
+
+	template <typename CharT>
+	constexpr bool is_whitespace(CharT c) {
+		return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+	}
+
+	template <typename CharT>
+	constexpr bool is_dash(CharT c) {
+		return (c == '-');
+	}
+
+	template <typename CharT>
+	constexpr bool is_quote(CharT c) {
+		return (c == '"');
+	}
+
+	template <typename CharT>
+	constexpr bool is_equal_sign(CharT c) {
+		return (c == '=');
+	}
+
+	/// Reports the short option cluster -abc as the bare flags a and b and the option c with value.
+	template <typename Handler, typename CharT>
+	void report_cluster(Handler & h, std::basic_string_view<CharT> cluster, std::basic_string_view<CharT> value) {
+		for (size_t i = 0; i + 1 < cluster.size(); ++i)
+			h.on_option(cluster.substr(i, 1), std::basic_string_view<CharT>{});
+		h.on_option(cluster.empty() ? cluster : cluster.substr(cluster.size() - 1), value);
+	}
+
+	/// A handler with on_short_options(cluster, value) takes the cluster whole, otherwise it is split by report_cluster.
+	template <typename Handler, typename CharT>
+	void report_short(Handler & h, std::basic_string_view<CharT> cluster, std::basic_string_view<CharT> value) {
+		if constexpr (requires { h.on_short_options(cluster, value); }) {
+			h.on_short_options(cluster, value);
+		} else {
+			report_cluster(h, cluster, value);
+		}
+	}
+
+	/// Resumable command line state machine.
+	/// Reports h.on_option(key, value) and h.on_arg(value), a bare flag is reported with a null value view.
+	/// A key after a single dash is a cluster of short options, see report_short.
+	/// Quoted tokens are tracked from their first char after the opening quote.
+	/// Vector selects the structural scanner, see structural_cursor.
+	template <typename CharT, bool Vector = true>
+	struct tokenizer {
+		parse_state ps = parse_state::none;
+		const CharT * token_start = nullptr;
+		/// pending key of a key=value pair, null data while there is none
+		std::basic_string_view<CharT> key;
+		/// the current token already has chars from an earlier chunk (streaming only)
+		bool continued = false;
+		/// the current or pending key followed a single dash
+		bool short_key = false;
+
+		/// single_value - the whole input is one argv entry, whitespace does not end a value
+		template <typename Handler>
+		void run(const CharT * s, const CharT * end, bool single_value, Handler & h) {
+			auto ps = this->ps;
+			const CharT * token_start = this->token_start;
+			auto key = this->key;
+			auto continued = this->continued;
+			auto short_key = this->short_key;
+			/// the mask of a block is only valid within this chunk
+			structural_cursor<CharT, Vector> scan{s};
+
+			const CharT * c = s;
+			while (c != end) {
+				switch (ps) {
+					case parse_state::none:
+						if (is_whitespace(*c)) {
+							/// skip
+						} else if (is_dash(*c)) {
+							ps = parse_state::key_prefix;
+							if (key.data())
+								report(h, short_key, key, std::basic_string_view<CharT>{});
+						} else if (is_quote(*c)) {
+							ps = parse_state::quoted_value;
+							token_start = c + 1;
+							continued = false;
+						} else {
+							ps = parse_state::value;
+							token_start = c;
+							continued = false;
+						}
+						break;
+					case parse_state::key_prefix:
+						if (is_dash(*c)) {
+							ps = parse_state::long_key_prefix;
+						} else if (is_whitespace(*c)) {
+							ps = parse_state::none;
+						} else {
+							ps = parse_state::key;
+							token_start = c;
+							continued = false;
+							short_key = true;
+						}
+						break;
+					case parse_state::long_key_prefix:
+						if (is_whitespace(*c)) {
+							ps = parse_state::none;
+						} else {
+							ps = parse_state::key;
+							token_start = c;
+							continued = false;
+							short_key = false;
+						}
+						break;
+					case parse_state::key:
+						if (is_whitespace(*c)) {
+							ps = parse_state::none;
+							if (c > token_start || continued) {
+								report(h, short_key, std::basic_string_view<CharT>{token_start, c}, std::basic_string_view<CharT>{});
+							}
+						} else if (is_equal_sign(*c)) {
+							ps = parse_state::value;
+							key = {token_start, c};
+							token_start = c + 1;
+							continued = false;
+						}
+						break;
+					case parse_state::value:
+						if (is_quote(*c) && token_start == c && !continued) {
+							ps = parse_state::quoted_value;
+							token_start = c + 1;
+						} else if (is_whitespace(*c) && !single_value) {
+							ps = parse_state::none;
+							if (key.data()) {
+								report(h, short_key, key, std::basic_string_view<CharT>{token_start, c});
+							} else {
+								h.on_arg(std::basic_string_view<CharT>{token_start, c});
+							}
+							key = {};
+						}
+						break;
+					case parse_state::quoted_value:
+						if (is_quote(*c)) {
+							ps = parse_state::none;
+							if (key.data()) {
+								report(h, short_key, key, std::basic_string_view<CharT>{token_start, c});
+							} else {
+								h.on_arg(std::basic_string_view<CharT>{token_start, c});
+							}
+							key = {};
+						}
+				}
+				/// plain chars never change the key and value states, jump to the next structural char
+				if (ps == parse_state::key || ps == parse_state::value || ps == parse_state::quoted_value) {
+					c = scan.next(c + 1, end);
+				} else {
+					c++;
+				}
+			}
+
+			this->ps = ps;
+			this->token_start = token_start;
+			this->key = key;
+			this->continued = continued;
+			this->short_key = short_key;
+		}
+
+		/// end of input at c, reports the trailing token
+		template <typename Handler>
+		void finish(const CharT * c, Handler & h) {
+			if (ps == parse_state::key && (token_start < c || continued)) {
+				report(h, short_key, std::basic_string_view<CharT>{token_start, c}, std::basic_string_view<CharT>{});
+			} else if (ps == parse_state::value) {
+				if (key.data()) {
+					report(h, short_key, key, std::basic_string_view<CharT>{token_start, c});
+				} else if (c > token_start || continued) { /// store only non empty free standing arguments
+					h.on_arg(std::basic_string_view<CharT>{token_start, c});
+				}
+			} else if (ps == parse_state::quoted_value) {
+				if (key.data()) {
+					report(h, short_key, key, std::basic_string_view<CharT>{token_start, c});
+				} else {
+					h.on_arg(std::basic_string_view<CharT>{token_start, c});
+				}
+			}
+			*this = {};
+		}
+
+		/// a short key is a cluster of short options
+		template <typename Handler>
+		static void report(Handler & h, bool short_key, std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+			if (short_key) {
+				report_short(h, key, value);
+			} else {
+				h.on_option(key, value);
+			}
+		}
+
+		[[nodiscard]] bool in_token() const noexcept {
+			return ps == parse_state::key || ps == parse_state::value || ps == parse_state::quoted_value;
+		}
+	};
+
+	/// Runs the command line state machine over [s, end), see tokenizer.
+	template <bool Vector = true, typename CharT, typename Handler>
+	void tokenize(const CharT * s, const CharT * end, bool single_value, Handler && h) {
+		tokenizer<CharT, Vector> t;
+		t.token_start = s;
+		t.run(s, end, single_value, h);
+		t.finish(end, h);
+	}
+
+	/// True if std::from_chars may consume c as part of a T: sign and digits, for floating point also
+	/// the point, the exponent and the letters of inf and nan(chars).
+	template <typename T>
+	constexpr bool is_number_char(char32_t c) noexcept {
+		if ((c >= '0' && c <= '9') || c == '-')
+			return true;
+		if constexpr (std::is_floating_point_v<T>) {
+			return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '.' || c == '+' || c == '_' || c == '(' || c == ')';
+		}
+		return false;
+	}
+
+	/// Parses a number from native chars with std::from_chars. Wide chars are narrowed up to the first one
+	/// from_chars could not consume, on the stack or on the heap for long values, so both char types agree.
+	template <typename T, typename CharT>
+	std::optional<T> to_number(std::basic_string_view<CharT> s) noexcept {
+		T value{};
+		if constexpr (std::is_same_v<CharT, char>) {
+			const auto r = std::from_chars(s.data(), s.data() + s.size(), value);
+			if (r.ec == std::errc())
+				return value;
+		} else {
+			size_t n = 0;
+			while (n < s.size() && is_number_char<T>(static_cast<char32_t>(static_cast<std::make_unsigned_t<CharT>>(s[n]))))
+				++n;
+			const auto parse = [&](char * narrow) {
+				for (size_t i = 0; i < n; ++i) {
+					narrow[i] = static_cast<char>(s[i]);
+				}
+				return std::from_chars(narrow, narrow + n, value).ec == std::errc();
+			};
+			char stack[128];
+			if (n <= sizeof(stack))
+				return parse(stack) ? std::optional<T>{value} : std::nullopt;
+			try {
+				std::string heap(n, '\0');
+				if (parse(heap.data()))
+					return value;
+			} catch (const std::bad_alloc &) {
+			}
+		}
+		return std::nullopt;
+	}
+
+	/// Typed option value: bool (bare flag is true), arithmetic types or a native string view.
+	template <typename T, typename Vocabulary = bool_vocabulary, typename CharT>
+	std::optional<T> convert_value(std::basic_string_view<CharT> s) noexcept {
+		if constexpr (std::is_same_v<T, bool>) {
+			if (s.empty())
+				return true;
+			return bool_recognizer<Vocabulary>::match(s);
+		} else if constexpr (std::is_arithmetic_v<T>) {
+			return to_number<T>(s);
+		} else {
+			static_assert(std::is_same_v<T, std::basic_string_view<CharT>>, "unsupported option value type");
+			return s;
+		}
+	}
+
+	/// FNV-1a over the chars of a key as seen by a CharT command line, narrow names are widened like compare_key does
+	template <typename CharT, typename KeyChar>
+	constexpr std::uint32_t hash_key(std::basic_string_view<KeyChar> key) noexcept {
+		std::uint32_t h = 2166136261u;
+		for (const auto c : key) {
+			h ^= static_cast<std::uint32_t>(static_cast<CharT>(c));
+			h *= 16777619u;
+		}
+		return h;
+	}
+
+	constexpr std::uint32_t mix_hash(std::uint32_t h) noexcept {
+		h ^= h >> 16;
+		h *= 0x85ebca6bu;
+		h ^= h >> 13;
+		h *= 0xc2b2ae35u;
+		h ^= h >> 16;
+		return h;
+	}
+
+	/// Minimal perfect hash over N distinct names, built at compile time by hash and displace:
+	/// a key picks a bucket, the bucket seed picks one of N slots, and no two names share a slot.
+	/// candidate() returns the only name index a key can match, the caller compares that single name.
+	template <typename CharT, size_t N>
+	struct perfect_hash {
+		static constexpr size_t bucket_count = N / 2 + 1;
+
+		std::array<std::uint32_t, bucket_count> seeds{};
+		std::array<std::uint32_t, N> slots{}; /// slot -> name index
+
+		constexpr explicit perfect_hash(const std::array<std::string_view, N> & names) {
+			std::array<std::uint32_t, N> hashes{};
+			std::array<size_t, bucket_count + 1> offsets{}; /// members of bucket b are members[offsets[b]..offsets[b + 1])
+			for (size_t i = 0; i < N; ++i) {
+				hashes[i] = hash_key<CharT>(names[i]);
+				++offsets[mix_hash(hashes[i]) % bucket_count + 1];
+			}
+			size_t largest = 0;
+			for (size_t b = 0; b < bucket_count; ++b) {
+				largest = std::max(largest, offsets[b + 1]);
+				offsets[b + 1] += offsets[b];
+			}
+			std::array<size_t, N> members{};
+			auto fill = offsets;
+			for (size_t i = 0; i < N; ++i)
+				members[fill[mix_hash(hashes[i]) % bucket_count]++] = i;
+
+			/// place the largest buckets first while most slots are free
+			std::array<bool, N> taken{};
+			for (size_t count = largest; count > 0; --count) {
+				for (size_t b = 0; b < bucket_count; ++b) {
+					if (offsets[b + 1] - offsets[b] != count)
+						continue;
+					for (std::uint32_t seed = 1;; ++seed) {
+						if (seed == 0x100000)
+							throw std::logic_error("no perfect hash found");
+						if (place(hashes, members, offsets[b], offsets[b + 1], seed, taken)) {
+							seeds[b] = seed;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		template <typename KeyChar>
+		[[nodiscard]] constexpr size_t candidate(std::basic_string_view<KeyChar> key) const noexcept {
+			if constexpr (N == 0) {
+				return 0;
+			} else {
+				const auto h = hash_key<CharT>(key);
+				return slots[slot(h, seeds[mix_hash(h) % bucket_count])];
+			}
+		}
+
+	private:
+		static constexpr size_t slot(std::uint32_t hash, std::uint32_t seed) noexcept {
+			return mix_hash(hash ^ seed) % N;
+		}
+
+		constexpr bool place(const std::array<std::uint32_t, N> & hashes, const std::array<size_t, N> & members,
+			size_t first, size_t last, std::uint32_t seed, std::array<bool, N> & taken) {
+			for (size_t m = first; m < last; ++m) {
+				const auto s = slot(hashes[members[m]], seed);
+				if (taken[s]) {
+					for (size_t u = first; u < m; ++u)
+						taken[slot(hashes[members[u]], seed)] = false;
+					return false;
+				}
+				taken[s] = true;
+			}
+			for (size_t m = first; m < last; ++m)
+				slots[slot(hashes[members[m]], seed)] = static_cast<std::uint32_t>(members[m]);
+			return true;
+		}
+	};
+
+	/// typed forms of an option value, converted once after parsing
+	struct converted_value {
+		std::optional<int> int_value;
+		std::optional<bool> bool_value;
+
+		template <typename CharT>
+		static converted_value from(std::basic_string_view<CharT> s) noexcept {
+			return {to_number<int>(s), convert_value<bool>(s)};
+		}
+	};
+
+	/// Set of ASCII chars, a lookup is a single bit test.
+	struct ascii_set {
+		std::uint64_t bits[2]{};
+
+		template <typename CharT>
+		constexpr void insert(CharT c) noexcept {
+			const auto u = static_cast<std::make_unsigned_t<CharT>>(c);
+			if (u < 128)
+				bits[u >> 6] |= std::uint64_t{1} << (u & 63);
+		}
+
+		template <typename CharT>
+		[[nodiscard]] constexpr bool contains(CharT c) const noexcept {
+			const auto u = static_cast<std::make_unsigned_t<CharT>>(c);
+			return u < 128 && ((bits[u >> 6] >> (u & 63)) & 1) != 0;
+		}
+	};
+
+	/// single char ASCII keys of (key, value) entries
+	template <typename Entries>
+	ascii_set short_keys_of(const Entries & entries) noexcept {
+		ascii_set set;
+		for (const auto & [k, v] : entries) {
+			if (k.size() == 1)
+				set.insert(k[0]);
+		}
+		return set;
+	}
+
+	/// transparent ordering of (key, value) entries against narrow lookup keys
+	struct key_less {
+		using is_transparent = void;
+
+		template <typename Entry>
+		constexpr bool operator()(const Entry & e, std::string_view key) const noexcept {
+			return compare_key(e.first, key) < 0;
+		}
+
+		template <typename Entry>
+		constexpr bool operator()(std::string_view key, const Entry & e) const noexcept {
+			return compare_key(e.first, key) > 0;
+		}
+	};
+} //ns detail
+
+
+namespace detail {
+	/// Read only memory mapping of a whole file, empty if the file could not be mapped.
+	class mapped_file {
+	public:
+		template <typename CharT>
+		explicit mapped_file(const CharT * path) noexcept {
+#if defined _WIN32
+			HANDLE file;
+			if constexpr (std::is_same_v<CharT, wchar_t>) {
+				file = ::CreateFileW(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+			} else {
+				file = ::CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+			}
+			if (file == INVALID_HANDLE_VALUE)
+				return;
+			LARGE_INTEGER file_size;
+			opened = ::GetFileSizeEx(file, &file_size) != 0;
+			if (opened && file_size.QuadPart > 0) {
+				mapping = ::CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+				if (mapping != NULL)
+					data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				opened = data != nullptr;
+				size = static_cast<size_t>(file_size.QuadPart);
+			}
+			::CloseHandle(file);
+#else
+			int fd;
+			if constexpr (std::is_same_v<CharT, char>) {
+				fd = ::open(path, O_RDONLY | O_CLOEXEC);
+			} else {
+				const auto narrow_path = wstrtoutf8(path);
+				fd = narrow_path ? ::open(narrow_path->c_str(), O_RDONLY | O_CLOEXEC) : -1;
+			}
+			if (fd < 0)
+				return;
+			struct stat st;
+			opened = ::fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+			if (opened && st.st_size > 0) {
+				void * p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+				opened = p != MAP_FAILED;
+				if (opened) {
+					data = p;
+					size = static_cast<size_t>(st.st_size);
+					::madvise(p, size, MADV_SEQUENTIAL);
+				}
+			}
+			::close(fd);
+#endif
+		}
+
+		mapped_file(const mapped_file &) = delete;
+		mapped_file & operator=(const mapped_file &) = delete;
+
+		~mapped_file() {
+#if defined _WIN32
+			if (data)
+				::UnmapViewOfFile(data);
+			if (mapping != NULL)
+				::CloseHandle(mapping);
+#else
+			if (data)
+				::munmap(const_cast<void *>(data), size);
+#endif
+		}
+
+		[[nodiscard]] bool is_open() const noexcept {
+			return opened;
+		}
+
+		/// mapped bytes as native chars, a trailing partial char is ignored
+		template <typename CharT>
+		[[nodiscard]] std::basic_string_view<CharT> chars() const noexcept {
+			if (!data)
+				return {};
+			return {static_cast<const CharT *>(data), size / sizeof(CharT)};
+		}
+
+	private:
+		const void * data = nullptr;
+		size_t size = 0;
+		bool opened = false;
+#if defined _WIN32
+		HANDLE mapping = NULL;
+#endif
+	};
+} //ns detail
+
+/// Lazy split of an option value at a delimiter, e.g. --hosts=a,b,c. Nothing is allocated, pieces are views into the value.
+/// With T = basic_string_view<CharT> the elements are the pieces, otherwise each piece is converted on access
+/// to std::optional<T> (bool, arithmetic types). An empty value has no elements, "a,,b" has an empty second one.
+template <typename CharT, typename T = std::basic_string_view<CharT>>
+class list_view {
+public:
+	using value_type = std::conditional_t<std::is_same_v<T, std::basic_string_view<CharT>>, T, std::optional<T>>;
+
+	class iterator {
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = list_view::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = void;
+		using reference = value_type;
+
+		iterator() = default;
+
+		[[nodiscard]] reference operator*() const noexcept {
+			const std::basic_string_view<CharT> piece{first, static_cast<size_t>(last - first)};
+			if constexpr (std::is_same_v<value_type, T>) {
+				return piece;
+			} else {
+				return detail::convert_value<T>(piece);
+			}
+		}
+
+		iterator & operator++() noexcept {
+			if (last == end) {
+				first = nullptr;
+			} else {
+				first = last + 1;
+				last = detail::find_char(first, end, delimiter);
+			}
+			return *this;
+		}
+
+		iterator operator++(int) noexcept {
+			auto copy = *this;
+			++*this;
+			return copy;
+		}
+
+		[[nodiscard]] friend bool operator==(const iterator & l, const iterator & r) noexcept {
+			return l.first == r.first;
+		}
+
+		[[nodiscard]] friend bool operator!=(const iterator & l, const iterator & r) noexcept {
+			return !(l == r);
+		}
+
+	private:
+		friend class list_view;
+
+		const CharT * first = nullptr; /// null past the last piece
+		const CharT * last = nullptr;
+		const CharT * end = nullptr;
+		CharT delimiter{};
+	};
+
+	list_view() = default;
+
+	list_view(std::basic_string_view<CharT> value, CharT delimiter) noexcept : value(value), delimiter(delimiter) {}
+
+	[[nodiscard]] iterator begin() const noexcept {
+		iterator it;
+		if (!value.empty()) {
+			it.first = value.data();
+			it.end = value.data() + value.size();
+			it.last = detail::find_char(it.first, it.end, delimiter);
+			it.delimiter = delimiter;
+		}
+		return it;
+	}
+
+	[[nodiscard]] iterator end() const noexcept {
+		return {};
+	}
+
+	[[nodiscard]] bool empty() const noexcept {
+		return value.empty();
+	}
+
+private:
+	std::basic_string_view<CharT> value;
+	CharT delimiter{};
+};
+
+namespace detail {
+#if defined __linux__
+	/// NUL separated arguments of the running process, argv[0] included
+	inline std::string read_process_cmdline() {
+		const int fd = ::open("/proc/self/cmdline", O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+			throw std::runtime_error("cannot open /proc/self/cmdline");
+		std::string res;
+		char buffer[4096];
+		for (;;) {
+			const auto n = ::read(fd, buffer, sizeof(buffer));
+			if (n < 0) {
+				::close(fd);
+				throw std::runtime_error("cannot read /proc/self/cmdline");
+			}
+			if (n == 0)
+				break;
+			res.append(buffer, static_cast<size_t>(n));
+		}
+		::close(fd);
+		return res;
+	}
+#endif
+
+	/// argv from NUL separated arguments, the trailing NUL is optional
+	inline std::vector<std::string_view> split_nul(std::string_view s) {
+		std::vector<std::string_view> argv;
+		while (!s.empty()) {
+			const auto n = std::min(s.find('\0'), s.size());
+			argv.push_back(s.substr(0, n));
+			s.remove_prefix(std::min(n + 1, s.size()));
+		}
+		return argv;
+	}
+} //ns detail
+
+namespace detail {
+	template <typename CharT>
+	using option_entry = std::pair<std::basic_string_view<CharT>, std::basic_string_view<CharT>>;
+
+	/// values of one key: values[first, first + count) of its command line
+	struct value_range {
+		size_t first = 0;
+		size_t count = 0;
+	};
+
+	/// Sorts the entries of opts from first on by key and collapses repeated keys.
+	/// The last assigned value wins, a bare flag (null value) never overrides an earlier value.
+	/// Every assigned value is appended to values, grouped by key in the order of opts and in parse order
+	/// within a key, ranges gets one entry per key relative to the size of values on entry.
+	/// Repeated keys must keep their parse order, sorted is caller provided scratch space for a sequenced copy
+	/// (std::stable_sort would take its temporary buffer from the global heap).
+	template <typename Entries, typename Scratch, typename Values, typename Ranges>
+	void build_index(Entries & opts, size_t first, Scratch & sorted, Values & values, Ranges & ranges) {
+		sorted.clear();
+		sorted.reserve(opts.size() - first);
+		for (size_t i = first; i < opts.size(); ++i) {
+			sorted.emplace_back(opts[i], i);
+		}
+		std::sort(std::begin(sorted), std::end(sorted), [](const auto & l, const auto & r) {
+			const auto c = l.first.first.compare(r.first.first);
+			return c < 0 || (c == 0 && l.second < r.second);
+		});
+		opts.resize(first);
+		const auto values_first = values.size();
+		for (auto it = std::begin(sorted); it != std::end(sorted);) {
+			const auto key = it->first.first;
+			const auto range_first = values.size() - values_first;
+			auto value = it->first.second;
+			if (value.data() != nullptr)
+				values.push_back(value);
+			for (++it; it != std::end(sorted) && it->first.first == key; ++it) {
+				if (it->first.second.data() != nullptr) {
+					value = it->first.second;
+					values.push_back(value);
+				}
+			}
+			opts.emplace_back(key, value);
+			ranges.push_back({range_first, values.size() - values_first - range_first});
+		}
+	}
+
+	/// Storage of option sources for layered and serialize, the sources befriend it.
+	struct source_access {
+		template <typename Source>
+		static auto entries(const Source & s) noexcept {
+			return s.entries();
+		}
+
+		template <typename Source>
+		static auto converted(const Source & s) noexcept {
+			return s.converted();
+		}
+
+		template <typename Source>
+		static auto values(const Source & s) noexcept {
+			return s.values();
+		}
+
+		template <typename Source>
+		static auto value_ranges(const Source & s) noexcept {
+			return s.value_ranges();
+		}
+
+		template <typename Source>
+		static const ascii_set & short_keys(const Source & s) noexcept {
+			return s.short_keys();
+		}
+	};
+
+	/// Lookup API shared by options and the views returned by parse_batch.
+	/// Derived provides entries() - (key, value) pairs sorted by key, converted() - the converted values
+	/// in the same order, values() and value_ranges() - every value of each key, see build_index,
+	/// short_keys() - the single char ASCII keys, and args() - the free standing arguments.
+	template <typename Derived, typename CharT>
+	class option_accessors {
+	public:
+		/// a single char ASCII key, e.g. a short flag, is a bit test
+		[[nodiscard]] bool has_opt(std::string_view key) const {
+			if (key.size() == 1 && static_cast<unsigned char>(key[0]) < 128)
+				return self().short_keys().contains(key[0]);
+			return find_opt(key) != nullptr;
+		}
+
+		[[nodiscard]] inline std::optional<std::basic_string_view<CharT>> get_native_string(std::string_view key) const noexcept {
+			const auto e = find_opt(key);
+			if (e == nullptr)
+				return std::nullopt;
+			return e->second;
+		}
+
+		/// value as UTF-8 string
+		[[nodiscard]] inline std::optional<std::string> get_string(std::string_view key) const noexcept {
+			const auto s = get_native_string(key);
+			if (!s.has_value())
+				return std::nullopt;
+			if constexpr (std::is_same_v<CharT, char>) {
+				return std::string{s.value()};
+			} else {
+				return wstrtoutf8(s.value());
+			}
+		}
+
+		[[nodiscard]] inline std::basic_string_view<CharT> get_native_string(std::string_view key, std::basic_string_view<CharT> default_value) const noexcept {
+			const auto v = get_native_string(key);
+			if (!v)
+				return default_value;
+			return *v;
+		}
+
+		[[nodiscard]] inline std::basic_string_view<CharT> get_required_native_string(std::string_view key) const {
+			const auto v = get_native_string(key);
+			if (!v.has_value()) {
+				throw std::out_of_range("option not provided");
+			}
+			return v.value();
+		}
+
+		/// Vocabulary lists accepted true/false tokens, see bool_vocabulary
+		template <typename Vocabulary = bool_vocabulary>
+		[[nodiscard]] bool get_bool(std::string_view key, bool default_value = false) const {
+			if constexpr (std::is_same_v<Vocabulary, bool_vocabulary>) {
+				const auto e = find_opt(key);
+				if (e == nullptr)
+					return default_value;
+				if (const auto & b = converted_at(e).bool_value)
+					return *b;
+			} else {
+				const auto v = get_native_string(key);
+				if (!v)
+					return default_value;
+				if (const auto b = convert_value<bool, Vocabulary>(*v))
+					return *b;
+			}
+			throw std::invalid_argument("boolean option argument not recognized");
+		}
+
+		[[nodiscard]] inline std::optional<int> get_int(std::string_view key) const noexcept {
+			const auto e = find_opt(key);
+			if (e == nullptr)
+				return std::nullopt;
+			return converted_at(e).int_value;
+		}
+
+		[[nodiscard]] int get_int(std::string_view key, int default_value) const noexcept {
+			const auto opt_value = get_int(key);
+			return opt_value.value_or(default_value);
+		}
+
+		/// Numeric value parsed with std::from_chars straight from the native view (int, int64_t, uint64_t, double, ...).
+		/// Wide chars are narrowed on the stack, nothing is allocated.
+		template <typename T>
+		[[nodiscard]] std::optional<T> get_number(std::string_view key) const noexcept {
+			static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "use get_bool for booleans");
+			const auto e = find_opt(key);
+			if (e == nullptr)
+				return std::nullopt;
+			if constexpr (std::is_same_v<T, int>) {
+				return converted_at(e).int_value;
+			} else {
+				return to_number<T>(e->second);
+			}
+		}
+
+		template <typename T>
+		[[nodiscard]] T get_number(std::string_view key, T default_value) const noexcept {
+			return get_number<T>(key).value_or(default_value);
+		}
+
+		/// Lazy split of the value at delimiter, see list_view. Empty for a missing option or a bare flag.
+		/// get_list<T> converts each piece on access, e.g. for (auto port : o.get_list<int>("ports")).
+		template <typename T = std::basic_string_view<CharT>>
+		[[nodiscard]] list_view<CharT, T> get_list(std::string_view key, CharT delimiter = ',') const noexcept {
+			const auto e = find_opt(key);
+			if (e == nullptr)
+				return {};
+			return {e->second, delimiter};
+		}
+
+		/// All values of a repeated option in command line order, e.g. {"a", "b"} for --include=a --include=b.
+		/// Bare flags are not listed, the span is empty for a missing option.
+		[[nodiscard]] std::span<const std::basic_string_view<CharT>> get_all(std::string_view key) const noexcept {
+			const auto e = find_opt(key);
+			if (e == nullptr)
+				return {};
+			const auto r = self().value_ranges()[static_cast<size_t>(e - self().entries().data())];
+			return self().values().subspan(r.first, r.count);
+		}
+
+		/// free standing argument at index
+		[[nodiscard]] inline const std::basic_string_view<CharT> arg(size_t index) const {
+			const auto & list = self().args();
+			if (index >= list.size())
+				throw std::out_of_range("argument index out of range");
+			return list[index];
+		}
+
+		[[nodiscard]] inline auto arg_count() const noexcept {
+			return self().args().size();
+		}
+
+	protected:
+		const option_entry<CharT> * find_opt(std::string_view key) const noexcept {
+			const auto opts = self().entries();
+			const auto it = std::lower_bound(std::begin(opts), std::end(opts), key, key_less{});
+			if (it != std::end(opts) && compare_key(it->first, key) == 0)
+				return &*it;
+			return nullptr;
+		}
+
+		const converted_value & converted_at(const option_entry<CharT> * e) const noexcept {
+			return self().converted()[static_cast<size_t>(e - self().entries().data())];
+		}
+
+	private:
+		const Derived & self() const noexcept {
+			return static_cast<const Derived &>(*this);
+		}
+	};
+} //ns detail
+
+/// Tag of the options constructors that copy their input, see options(copy_input_t, ...).
+struct copy_input_t {
+	explicit copy_input_t() = default;
+};
+inline constexpr copy_input_t copy_input{};
+
+/// Parsed command line, keys and values are views into the input.
+/// All internal storage comes from Allocator, see yopt::pmr::options for arena backed parsing.
+/// Constructed with copy_input the input is copied into a single owned buffer first, such options are
+/// self-contained and keep their views valid when copied or moved.
+template <typename CharT, typename Allocator = std::allocator<CharT>>
+class options : public detail::option_accessors<options<CharT, Allocator>, CharT> {
+	template <typename T>
+	using rebind_alloc = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+
+public:
+	using char_type = CharT;
+	using allocator_type = Allocator;
+
+	/// An @path argument is replaced by the contents of that response file (see parse_arg).
+	options(int argc, const CharT * const * argv, const Allocator & alloc = Allocator())
+		: a(alloc), opts(alloc), conv(alloc), vals(alloc), ranges(alloc), files(alloc), own(alloc) {
+		/// start from 1 - skip program name
+		for (int i = 1; i < argc; i++) {
+			parse_arg({argv[i], std::min(std::char_traits<CharT>::length(argv[i]), max_length)});
+		}
+		build_index();
+	}
+
+	/// arguments of known length, argv[0] is the program name and skipped
+	options(int argc, const std::basic_string_view<CharT> * argv, const Allocator & alloc = Allocator())
+		: a(alloc), opts(alloc), conv(alloc), vals(alloc), ranges(alloc), files(alloc), own(alloc) {
+		for (int i = 1; i < argc; i++) {
+			parse_arg(argv[i]);
+		}
+		build_index();
+	}
+
+	options(const CharT * cmd_line, const Allocator & alloc = Allocator())
+		: a(alloc), opts(alloc), conv(alloc), vals(alloc), ranges(alloc), files(alloc), own(alloc) {
+		parse(cmd_line);
+		build_index();
+	}
+
+	/// command line of known length, not limited by max_length
+	options(std::basic_string_view<CharT> cmd_line, const Allocator & alloc = Allocator())
+		: a(alloc), opts(alloc), conv(alloc), vals(alloc), ranges(alloc), files(alloc), own(alloc) {
+		parse(cmd_line.data(), cmd_line.data() + cmd_line.size());
+		build_index();
+	}
+
+	/// Owning mode: cmd_line is copied once into an owned buffer and parsed there, it may be a temporary.
+	options(copy_input_t, std::basic_string_view<CharT> cmd_line, const Allocator & alloc = Allocator())
+		: a(alloc), opts(alloc), conv(alloc), vals(alloc), ranges(alloc), files(alloc), own(alloc) {
+		own.reserve(cmd_line.size() + 1);
+		own.assign(std::begin(cmd_line), std::end(cmd_line));
+		own.push_back(CharT{});
+		parse(own.data(), own.data() + cmd_line.size());
+		build_index();
+	}
+
+	/// Owning mode of options(argc, argv): all arguments are copied once into one owned buffer.
+	options(copy_input_t, int argc, const CharT * const * argv, const Allocator & alloc = Allocator())
+		: a(alloc), opts(alloc), conv(alloc), vals(alloc), ranges(alloc), files(alloc), own(alloc) {
+		size_t size = 0;
+		for (int i = 1; i < argc; i++) {
+			size += std::min(std::char_traits<CharT>::length(argv[i]), max_length) + 1;
+		}
+		own.reserve(size);
+		for (int i = 1; i < argc; i++) {
+			own.insert(std::end(own), argv[i], argv[i] + std::min(std::char_traits<CharT>::length(argv[i]), max_length));
+			own.push_back(CharT{});
+		}
+		for (auto p = own.data(); p != own.data() + own.size(); p += std::char_traits<CharT>::length(p) + 1) {
+			parse_arg(p);
+		}
+		build_index();
+	}
+
+	options(const options & other)
+		: a(other.a), opts(other.opts), conv(other.conv), vals(other.vals), ranges(other.ranges), shorts(other.shorts),
+		  files(other.files), own(other.own) {
+		rebase(other.own.data());
+	}
+
+	/// a moved vector keeps its storage, the views stay valid
+	options(options &&) noexcept = default;
+
+	options & operator=(const options & other) {
+		if (this != &other) {
+			assign_from(other, other.own.data());
+		}
+		return *this;
+	}
+
+	options & operator=(options && other) {
+		if (this != &other) {
+			const auto old = other.own.data();
+			assign_from(std::move(other), old);
+		}
+		return *this;
+	}
+
+	/// Command line of the running process, for code that never sees main's argv.
+	/// Parsed like options(argc, argv) on first use, the process-wide instance is initialized once and thread-safe.
+	/// Linux only, reads /proc/self/cmdline, elsewhere throws std::runtime_error.
+	[[nodiscard]] static const options & from_process() {
+		static_assert(std::is_same_v<CharT, char> && std::is_same_v<Allocator, std::allocator<char>>, "from_process is available for options<char> only");
+#if defined __linux__
+		struct process {
+			const std::string cmdline = detail::read_process_cmdline();
+			const std::vector<std::string_view> argv = detail::split_nul(cmdline);
+			const options o{static_cast<int>(argv.size()), argv.data()};
+		};
+		static const process instance;
+		return instance.o;
+#else
+		throw std::runtime_error("process command line not available");
+#endif
+	}
+
+	[[nodiscard]] allocator_type get_allocator() const noexcept {
+		return allocator_type(a.get_allocator());
+	}
+
+	[[nodiscard]] inline const auto & args() const noexcept {
+		return a;
+	}
+
+private:
+	friend class detail::option_accessors<options, CharT>;
+	friend struct detail::source_access;
+
+	using entry = detail::option_entry<CharT>;
+
+	std::vector<std::basic_string_view<CharT>, rebind_alloc<std::basic_string_view<CharT>>> a; /// free standing values
+	/// parsed key values, flat and sorted by key once parsing is done
+	std::vector<entry, rebind_alloc<entry>> opts;
+	/// Eagerly converted values, same order as opts.
+	/// Never modified after construction, so concurrent readers need no synchronization.
+	std::vector<detail::converted_value, rebind_alloc<detail::converted_value>> conv;
+	/// every value of every key grouped by key, ranges follows the order of opts
+	std::vector<std::basic_string_view<CharT>, rebind_alloc<std::basic_string_view<CharT>>> vals;
+	std::vector<detail::value_range, rebind_alloc<detail::value_range>> ranges;
+	detail::ascii_set shorts;
+	/// Response file contents, keys and values may point into them.
+	/// A detail::mapped_file for char, a vector of transcoded chars for wchar_t.
+	std::vector<std::shared_ptr<const void>, rebind_alloc<std::shared_ptr<const void>>> files;
+	/// owned copy of the input with a trailing NUL, empty unless constructed with copy_input
+	std::vector<CharT, rebind_alloc<CharT>> own;
+
+	/// all members from other, then views into the owned input of other at old are moved to own
+	template <typename Other>
+	void assign_from(Other && other, const CharT * old) {
+		a = std::forward<Other>(other).a;
+		opts = std::forward<Other>(other).opts;
+		conv = std::forward<Other>(other).conv;
+		vals = std::forward<Other>(other).vals;
+		ranges = std::forward<Other>(other).ranges;
+		shorts = other.shorts;
+		files = std::forward<Other>(other).files;
+		const auto old_size = other.own.size();
+		own = std::forward<Other>(other).own;
+		rebase(old, old_size);
+	}
+
+	/// views into [old, old + own.size()) now point at the same offset of own
+	void rebase(const CharT * old) noexcept {
+		rebase(old, own.size());
+	}
+
+	void rebase(const CharT * old, size_t old_size) noexcept {
+		if (old == nullptr || old == own.data())
+			return;
+		const auto move = [&](std::basic_string_view<CharT> & v) {
+			if (std::less_equal<const CharT *>{}(old, v.data()) && std::less<const CharT *>{}(v.data(), old + old_size))
+				v = {own.data() + (v.data() - old), v.size()};
+		};
+		for (auto & [k, v] : opts) {
+			move(k);
+			move(v);
+		}
+		for (auto & v : vals) {
+			move(v);
+		}
+		for (auto & v : a) {
+			move(v);
+		}
+	}
+
+	/// NUL terminated input, capped at max_length chars
+	void parse(const CharT * s, bool single_value = false) {
+		parse(s, s + std::min(std::char_traits<CharT>::length(s), max_length), single_value);
+	}
+
+	/// Single argv entry. "@path" is replaced by the contents of the response file at path: a memory mapped
+	/// UTF-8 command line, a leading byte order mark is skipped. For char options keys and values point straight
+	/// into the mapping, wide options transcode the file once into a buffer they own and throw std::runtime_error
+	/// if it is not valid UTF-8. Response files may nest up to response_file_max_depth levels.
+	/// An @path that cannot be opened stays a literal argument.
+	void parse_arg(std::basic_string_view<CharT> arg, size_t depth = 0) {
+		if (response_file_max_depth > 0 && arg.size() > 1 && arg[0] == '@') {
+			if (depth == response_file_max_depth)
+				throw std::runtime_error("response files nested too deep");
+			const std::basic_string<CharT> path{arg.substr(1)};
+			auto file = std::allocate_shared<const detail::mapped_file>(files.get_allocator(), path.c_str());
+			if (file->is_open()) {
+				auto content = file->template chars<char>();
+				if (content.substr(0, 3) == "\xEF\xBB\xBF")
+					content.remove_prefix(3);
+				if constexpr (std::is_same_v<CharT, char>) {
+					files.push_back(std::move(file));
+					parse_response_file(content, depth + 1);
+				} else {
+					auto wide = std::allocate_shared<std::vector<CharT, rebind_alloc<CharT>>>(files.get_allocator(), files.get_allocator());
+					if (!detail::utf8towstr(content, *wide))
+						throw std::runtime_error("response file is not valid UTF-8");
+					files.push_back(wide);
+					parse_response_file({wide->data(), wide->size()}, depth + 1);
+				}
+				return;
+			}
+		}
+		parse(arg.data(), arg.data() + arg.size(), true);
+	}
+
+	void parse_response_file(std::basic_string_view<CharT> content, size_t depth) {
+		struct collector {
+			options & o;
+			size_t depth;
+
+			void on_option(std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+				o.opts.emplace_back(key, value);
+			}
+
+			void on_arg(std::basic_string_view<CharT> value) {
+				if (value.size() > 1 && value[0] == '@') {
+					o.parse_arg(value, depth);
+				} else {
+					o.a.emplace_back(value);
+				}
+			}
+		};
+		detail::tokenize(content.data(), content.data() + content.size(), false, collector{*this, depth});
+	}
+
+	/// input of known length, [s, end) is parsed as a whole and NUL has no special meaning
+	void parse(const CharT * s, const CharT * end, bool single_value = false) {
+		struct collector {
+			options & o;
+
+			void on_option(std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+				o.opts.emplace_back(key, value);
+			}
+
+			void on_arg(std::basic_string_view<CharT> value) {
+				o.a.emplace_back(value);
+			}
+		};
+		detail::tokenize(s, end, single_value, collector{*this});
+	}
+
+	void build_index() {
+		using sequenced = std::pair<entry, size_t>;
+		std::vector<sequenced, rebind_alloc<sequenced>> sorted(opts.get_allocator());
+		ranges.reserve(opts.size());
+		detail::build_index(opts, 0, sorted, vals, ranges);
+		shorts = detail::short_keys_of(opts);
+
+		conv.reserve(opts.size());
+		for (const auto & [k, v] : opts) {
+			conv.push_back(detail::converted_value::from(v));
+		}
+	}
+
+	std::span<const entry> entries() const noexcept {
+		return {opts.data(), opts.size()};
+	}
+
+	std::span<const detail::converted_value> converted() const noexcept {
+		return {conv.data(), conv.size()};
+	}
+
+	std::span<const std::basic_string_view<CharT>> values() const noexcept {
+		return {vals.data(), vals.size()};
+	}
+
+	std::span<const detail::value_range> value_ranges() const noexcept {
+		return {ranges.data(), ranges.size()};
+	}
+
+	const detail::ascii_set & short_keys() const noexcept {
+		return shorts;
+	}
+};
+
+template <typename CharT>
+inline std::basic_string_view<CharT> strip_quotes(const std::basic_string_view<CharT> & s) {
+	auto b = cbegin(s);
+	if (*b == '"' && b != end(s))
+		++b;
+	auto e = cend(s);
+	if (e != b) {
+		--e;
+		if (*e == '"' && e != b) {
+			--e;
+		}
+	}
+	return std::basic_string_view<CharT>{b, e+1};
+}
+
+/// Non-owning view of one command line parsed by parse_batch, same lookup API as options.
+template <typename CharT>
+class basic_options_view : public detail::option_accessors<basic_options_view<CharT>, CharT> {
+public:
+	using char_type = CharT;
+
+	basic_options_view() = default;
+
+	[[nodiscard]] inline std::span<const std::basic_string_view<CharT>> args() const noexcept {
+		return a;
+	}
+
+private:
+	friend class detail::option_accessors<basic_options_view, CharT>;
+	template <typename> friend class batch;
+	friend struct detail::source_access;
+
+	std::span<const detail::option_entry<CharT>> opts;
+	std::span<const detail::converted_value> conv;
+	std::span<const std::basic_string_view<CharT>> vals;
+	std::span<const detail::value_range> ranges;
+	std::span<const std::basic_string_view<CharT>> a;
+	detail::ascii_set shorts;
+
+	std::span<const detail::option_entry<CharT>> entries() const noexcept {
+		return opts;
+	}
+
+	std::span<const detail::converted_value> converted() const noexcept {
+		return conv;
+	}
+
+	std::span<const std::basic_string_view<CharT>> values() const noexcept {
+		return vals;
+	}
+
+	std::span<const detail::value_range> value_ranges() const noexcept {
+		return ranges;
+	}
+
+	const detail::ascii_set & short_keys() const noexcept {
+		return shorts;
+	}
+};
+
+/// Result of parse_batch: the options, converted values, repeated values and arguments of all command lines
+/// live in shared contiguous arrays, operator[] returns the view of one command line. Views stay valid while the
+/// batch lives, also across moves.
+template <typename CharT>
+class batch {
+public:
+	using char_type = CharT;
+	using view_type = basic_options_view<CharT>;
+
+	batch(std::span<const CharT * const> cmd_lines, unsigned threads);
+
+	batch(batch &&) noexcept = default;
+	batch & operator=(batch &&) noexcept = default;
+	batch(const batch &) = delete;
+	batch & operator=(const batch &) = delete;
+
+	[[nodiscard]] size_t size() const noexcept {
+		return views.size();
+	}
+
+	[[nodiscard]] const view_type & operator[](size_t index) const noexcept {
+		return views[index];
+	}
+
+	[[nodiscard]] auto begin() const noexcept {
+		return std::begin(views);
+	}
+
+	[[nodiscard]] auto end() const noexcept {
+		return std::end(views);
+	}
+
+private:
+	using entry = detail::option_entry<CharT>;
+
+	std::vector<entry> opts;
+	std::vector<detail::converted_value> conv;
+	std::vector<std::basic_string_view<CharT>> vals;
+	std::vector<detail::value_range> ranges; /// same order as opts, relative to the values of their command line
+	std::vector<std::basic_string_view<CharT>> a;
+	std::vector<view_type> views;
+
+	/// options, values and arguments of one command line
+	struct line_counts {
+		size_t opts = 0;
+		size_t vals = 0;
+		size_t args = 0;
+	};
+
+	/// what one worker parsed from a contiguous range of command lines
+	struct part {
+		std::vector<entry> opts;
+		std::vector<detail::converted_value> conv;
+		std::vector<std::basic_string_view<CharT>> vals;
+		std::vector<detail::value_range> ranges;
+		std::vector<std::basic_string_view<CharT>> a;
+		std::vector<line_counts> counts;
+		size_t opts_offset = 0;
+		size_t vals_offset = 0;
+		size_t args_offset = 0;
+	};
+
+	/// Runs first(i) and then second(i) for i in [0, count) on count threads, the same threads run both phases.
+	/// between() runs once on the calling thread after every first(i) returned, second runs only if nothing threw.
+	/// The first exception, also one from starting a thread, is rethrown once every started thread is joined.
+	template <typename First, typename Between, typename Second>
+	static void run_phases(size_t count, First && first, Between && between, Second && second) {
+		if (count == 1) {
+			first(0);
+			between();
+			second(0);
+			return;
+		}
+		enum class phase { first, second, cancel };
+		std::vector<std::exception_ptr> errors(count);
+		std::mutex m;
+		std::condition_variable cv;
+		size_t done = 0;
+		phase next = phase::first;
+		const auto release = [&](phase p) {
+			{
+				std::lock_guard lock{m};
+				next = p;
+			}
+			cv.notify_all();
+		};
+		std::vector<std::thread> workers;
+		const auto join = [&] {
+			for (auto & w : workers) {
+				w.join();
+			}
+		};
+		try {
+			workers.reserve(count);
+			for (size_t i = 0; i < count; ++i) {
+				workers.emplace_back([&, i] {
+					try {
+						first(i);
+					} catch (...) {
+						errors[i] = std::current_exception();
+					}
+					std::unique_lock lock{m};
+					++done;
+					cv.notify_all();
+					cv.wait(lock, [&] { return next != phase::first; });
+					if (next == phase::cancel)
+						return;
+					lock.unlock();
+					try {
+						second(i);
+					} catch (...) {
+						errors[i] = std::current_exception();
+					}
+				});
+			}
+			bool failed;
+			{
+				std::unique_lock lock{m};
+				cv.wait(lock, [&] { return done == count; });
+				failed = std::any_of(std::begin(errors), std::end(errors), [](const auto & e) { return e != nullptr; });
+			}
+			if (!failed)
+				between();
+			release(failed ? phase::cancel : phase::second);
+		} catch (...) {
+			release(phase::cancel);
+			join();
+			throw;
+		}
+		join();
+		for (const auto & e : errors) {
+			if (e)
+				std::rethrow_exception(e);
+		}
+	}
+
+	static void parse_part(part & p, std::span<const CharT * const> lines) {
+		struct collector {
+			part & p;
+
+			void on_option(std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+				p.opts.emplace_back(key, value);
+			}
+
+			void on_arg(std::basic_string_view<CharT> value) {
+				p.a.emplace_back(value);
+			}
+		};
+		std::vector<std::pair<entry, size_t>> sorted;
+		p.counts.reserve(lines.size());
+		for (const CharT * s : lines) {
+			const auto opts_first = p.opts.size();
+			const auto vals_first = p.vals.size();
+			const auto args_first = p.a.size();
+			detail::tokenize(s, s + std::min(std::char_traits<CharT>::length(s), max_length), false, collector{p});
+			detail::build_index(p.opts, opts_first, sorted, p.vals, p.ranges);
+			p.counts.push_back({p.opts.size() - opts_first, p.vals.size() - vals_first, p.a.size() - args_first});
+		}
+		p.conv.reserve(p.opts.size());
+		for (const auto & [k, v] : p.opts) {
+			p.conv.push_back(detail::converted_value::from(v));
+		}
+	}
+};
+
+template <typename CharT>
+batch<CharT>::batch(std::span<const CharT * const> cmd_lines, unsigned threads) {
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	const size_t part_count = std::max<size_t>(1, std::min<size_t>(threads, cmd_lines.size()));
+	const size_t per_part = (cmd_lines.size() + part_count - 1) / part_count;
+	const auto lines_of = [&](size_t i) {
+		const auto first = std::min(i * per_part, cmd_lines.size());
+		return cmd_lines.subspan(first, std::min(per_part, cmd_lines.size() - first));
+	};
+
+	std::vector<part> parts(part_count);
+	/// every worker parses its lines, then one allocation per shared array, then every worker copies its results
+	/// into its own slice
+	const auto parse = [&](size_t i) {
+		parse_part(parts[i], lines_of(i));
+	};
+	const auto allocate = [&] {
+		size_t opts_total = 0;
+		size_t vals_total = 0;
+		size_t args_total = 0;
+		for (auto & p : parts) {
+			p.opts_offset = opts_total;
+			p.vals_offset = vals_total;
+			p.args_offset = args_total;
+			opts_total += p.opts.size();
+			vals_total += p.vals.size();
+			args_total += p.a.size();
+		}
+		opts.resize(opts_total);
+		conv.resize(opts_total);
+		ranges.resize(opts_total);
+		vals.resize(vals_total);
+		a.resize(args_total);
+		views.resize(cmd_lines.size());
+	};
+	const auto copy = [&](size_t i) {
+		const auto & p = parts[i];
+		std::copy(std::begin(p.opts), std::end(p.opts), std::begin(opts) + p.opts_offset);
+		std::copy(std::begin(p.conv), std::end(p.conv), std::begin(conv) + p.opts_offset);
+		std::copy(std::begin(p.ranges), std::end(p.ranges), std::begin(ranges) + p.opts_offset);
+		std::copy(std::begin(p.vals), std::end(p.vals), std::begin(vals) + p.vals_offset);
+		std::copy(std::begin(p.a), std::end(p.a), std::begin(a) + p.args_offset);
+		auto opts_offset = p.opts_offset;
+		auto vals_offset = p.vals_offset;
+		auto args_offset = p.args_offset;
+		auto * view = views.data() + i * per_part;
+		for (const auto & c : p.counts) {
+			view->opts = {opts.data() + opts_offset, c.opts};
+			view->conv = {conv.data() + opts_offset, c.opts};
+			view->ranges = {ranges.data() + opts_offset, c.opts};
+			view->vals = {vals.data() + vals_offset, c.vals};
+			view->a = {a.data() + args_offset, c.args};
+			view->shorts = detail::short_keys_of(view->opts);
+			opts_offset += c.opts;
+			vals_offset += c.vals;
+			args_offset += c.args;
+			++view;
+		}
+	};
+	run_phases(part_count, parse, allocate, copy);
+}
+
+/// Parses many NUL terminated command lines in parallel on threads (0 - hardware concurrency). Each thread parses
+/// a contiguous range of the lines and then copies its results into the shared arrays of the batch.
+/// Each command line is capped at max_length chars, like options(const CharT *).
+template <typename CharT>
+[[nodiscard]] batch<CharT> parse_batch(std::span<const CharT * const> cmd_lines, unsigned threads = 0) {
+	return batch<CharT>{cmd_lines, threads};
+}
+
+/// Runs the options tokenizer and calls visitor.on_option(key, value) and visitor.on_arg(value) inline,
+/// a bare flag is reported with a null value view. Nothing is stored or allocated.
+/// -abc=value is reported as the flags a, b and the option c=value, unless the visitor has
+/// on_short_options(cluster, value) to take the cluster whole.
+/// NUL terminated input is capped at max_length chars, like options(const CharT *).
+template <typename CharT, typename Visitor>
+void parse(const CharT * cmd_line, Visitor && visitor) {
+	detail::tokenize(cmd_line, cmd_line + std::min(std::char_traits<CharT>::length(cmd_line), max_length), false, visitor);
+}
+
+template <typename CharT, typename Visitor>
+void parse(std::basic_string_view<CharT> cmd_line, Visitor && visitor) {
+	detail::tokenize(cmd_line.data(), cmd_line.data() + cmd_line.size(), false, visitor);
+}
+
+/// argv[0] is the program name and skipped. @path arguments are reported as is, response files are not read.
+template <typename CharT, typename Visitor>
+void parse(int argc, const CharT * const * argv, Visitor && visitor) {
+	for (int i = 1; i < argc; i++) {
+		const CharT * s = argv[i];
+		detail::tokenize(s, s + std::min(std::char_traits<CharT>::length(s), max_length), true, visitor);
+	}
+}
+
+/// Incremental parser for a command line arriving in chunks, e.g. over a pipe or a socket.
+/// Reports visitor.on_option(key, value) and visitor.on_arg(value) as soon as a token completes,
+/// a bare flag is reported with a null value view. Views are valid during the callback only.
+/// Tokens are viewed in place, only a token straddling a chunk boundary is copied.
+/// Visitor may be a reference type.
+template <typename CharT, typename Visitor>
+class basic_stream_parser {
+public:
+	explicit basic_stream_parser(Visitor visitor) : v(std::forward<Visitor>(visitor)) {}
+
+	void feed(std::basic_string_view<CharT> chunk) {
+		if (chunk.empty())
+			return;
+		begin = chunk.data();
+		t.token_start = begin;
+		t.continued = !carry.empty();
+		joiner j{*this};
+		t.run(begin, begin + chunk.size(), false, j);
+		save_token(begin + chunk.size());
+	}
+
+	/// end of input, reports the trailing token and resets the parser for the next command line
+	void finish() {
+		begin = carry.data() + carry.size();
+		t.token_start = begin;
+		t.continued = !carry.empty();
+		joiner j{*this};
+		t.finish(begin, j);
+		carry.clear();
+		key_carry.clear();
+	}
+
+	Visitor & visitor() noexcept {
+		return v;
+	}
+
+private:
+	/// prefixes the carried chars to the token continuing at the start of the current chunk
+	struct joiner {
+		basic_stream_parser & p;
+
+		std::basic_string_view<CharT> join(std::basic_string_view<CharT> s) {
+			if (p.carry.empty() || s.data() != p.begin)
+				return s;
+			p.carry.append(s);
+			p.joined.swap(p.carry);
+			p.carry.clear();
+			return p.joined;
+		}
+		void on_option(std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+			key = join(key);
+			value = join(value);
+			p.v.on_option(key, value);
+		}
+		/// a cluster is split only once it is whole
+		void on_short_options(std::basic_string_view<CharT> cluster, std::basic_string_view<CharT> value) {
+			cluster = join(cluster);
+			value = join(value);
+			detail::report_short(p.v, cluster, value);
+		}
+		void on_arg(std::basic_string_view<CharT> value) {
+			p.v.on_arg(join(value));
+		}
+	};
+
+	/// copies the unfinished token and a pending key out of the chunk ending at end
+	void save_token(const CharT * end) {
+		if (t.key.data() && t.key.data() != key_carry.data()) {
+			if (t.key.data() == begin && !carry.empty()) {
+				carry.append(t.key);
+				key_carry.swap(carry);
+				carry.clear();
+			} else {
+				key_carry.assign(t.key);
+			}
+			t.key = key_carry;
+		}
+		if (!t.in_token()) {
+			carry.clear();
+		} else if (t.token_start == begin) {
+			carry.append(t.token_start, end);
+		} else {
+			carry.assign(t.token_start, end);
+		}
+	}
 
+	Visitor v;
+	detail::tokenizer<CharT> t;
+	const CharT * begin = nullptr;
+	std::basic_string<CharT> carry;
+	std::basic_string<CharT> key_carry;
+	std::basic_string<CharT> joined;
+};
 
-namespace yopt {
+/// Snapshot of environment variables with the options lookup API, e.g. MYAPP_THREADS=8 read as get_int("threads").
+/// Only variables starting with prefix are kept and the prefix is stripped. With normalize keys are lower cased
+/// and '_' becomes '-', so MYAPP_MAX_JOBS is "max-jobs". Names and values are copied once into a single buffer,
+/// later setenv calls do not affect the snapshot and lookups are binary searches without touching environ.
+class environment : public detail::option_accessors<environment, char> {
+public:
+	using char_type = char;
 
-inline constexpr size_t max_length = YOPT_CMD_MAX_LENGTH;
+	/// snapshot of the process environment
+	explicit environment(std::string_view prefix = {}, bool normalize = true)
+		: environment(process_environment(), prefix, normalize) {}
+
+	/// snapshot of a null terminated NAME=value array such as envp
+	environment(const char * const * envp, std::string_view prefix = {}, bool normalize = true) {
+		std::vector<entry> found;
+		size_t size = 0;
+		for (auto e = envp; e && *e; ++e) {
+			const std::string_view var{*e};
+			const auto eq = var.find('=');
+			if (eq == std::string_view::npos || var.compare(0, prefix.size(), prefix) != 0 || eq <= prefix.size())
+				continue;
+			found.emplace_back(var.substr(prefix.size(), eq - prefix.size()), var.substr(eq + 1));
+			size += var.size() - prefix.size();
+		}
+
+		/// keys and values are rebased into buffer, sized up front so the views stay put
+		buffer.resize(size);
+		opts.reserve(found.size());
+		auto out = buffer.data();
+		for (const auto & [k, v] : found) {
+			const auto key = out;
+			out = std::copy(k.begin(), k.end(), out);
+			if (normalize) {
+				std::transform(key, out, key, [](char c) {
+					return c == '_' ? '-' : (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+				});
+			}
+			const auto value = out;
+			out = std::copy(v.begin(), v.end(), out);
+			opts.emplace_back(std::string_view{key, k.size()}, std::string_view{value, v.size()});
+		}
+
+		std::vector<std::pair<entry, size_t>> sorted;
+		ranges.reserve(opts.size());
+		detail::build_index(opts, 0, sorted, vals, ranges);
+		shorts = detail::short_keys_of(opts);
+		conv.reserve(opts.size());
+		for (const auto & [k, v] : opts) {
+			conv.push_back(detail::converted_value::from(v));
+		}
+	}
+
+	environment(environment &&) noexcept = default;
+	environment & operator=(environment &&) noexcept = default;
+	environment(const environment &) = delete;
+	environment & operator=(const environment &) = delete;
+
+	/// environment variables have no free standing arguments
+	[[nodiscard]] std::span<const std::string_view> args() const noexcept {
+		return {};
+	}
+
+private:
+	friend class detail::option_accessors<environment, char>;
+	friend struct detail::source_access;
+
+	using entry = detail::option_entry<char>;
+
+	std::vector<char> buffer; /// normalized names and values, a moved vector keeps its storage
+	std::vector<entry> opts;
+	std::vector<detail::converted_value> conv;
+	std::vector<std::string_view> vals;
+	std::vector<detail::value_range> ranges;
+	detail::ascii_set shorts;
+
+	static const char * const * process_environment() noexcept {
+#if defined _WIN32
+		return _environ;
+#else
+		return environ;
+#endif
+	}
+
+	std::span<const entry> entries() const noexcept {
+		return opts;
+	}
+
+	std::span<const detail::converted_value> converted() const noexcept {
+		return conv;
+	}
+
+	std::span<const std::string_view> values() const noexcept {
+		return vals;
+	}
+
+	std::span<const detail::value_range> value_ranges() const noexcept {
+		return ranges;
+	}
+
+	const detail::ascii_set & short_keys() const noexcept {
+		return shorts;
+	}
+};
+
+/// Option sources merged by priority, e.g. command line > environment > config file > defaults, highest first.
+/// The merged index is built once at construction, every key resolves to the value of the first source that has
+/// it with a single lookup and layer_of(key) tells which source that was. Keys and values stay views into the
+/// sources, which must outlive the resolver. Free standing arguments are those of the first source.
+/// Defaults are one more source, e.g. yopt::options{"--threads=4 --verbose=no"} as the last layer.
+template <typename CharT>
+class layered : public detail::option_accessors<layered<CharT>, CharT> {
+public:
+	using char_type = CharT;
+
+	/// options, environment (char only), parse_batch views or other resolvers
+	template <typename Source, typename... Sources>
+	explicit layered(const Source & first, const Sources &... rest) {
+		const auto & first_args = first.args();
+		a = {std::data(first_args), std::size(first_args)};
+
+		std::vector<candidate> all;
+		size_t layer = 0;
+		(collect(first, layer++, all), ..., collect(rest, layer++, all));
+		std::sort(std::begin(all), std::end(all), [](const candidate & l, const candidate & r) {
+			const auto c = l.key.compare(r.key);
+			return c < 0 || (c == 0 && l.layer < r.layer);
+		});
+
+		opts.reserve(all.size());
+		for (auto it = std::begin(all); it != std::end(all);) {
+			const auto & winner = *it;
+			opts.emplace_back(winner.key, winner.value);
+			conv.push_back(winner.conv);
+			layers.push_back(winner.layer);
+			ranges.push_back({vals.size(), winner.values.size()});
+			vals.insert(std::end(vals), std::begin(winner.values), std::end(winner.values));
+			for (++it; it != std::end(all) && it->key == winner.key; ++it) {}
+		}
+		shorts = detail::short_keys_of(opts);
+	}
+
+	/// index of the source the value of key comes from, nullopt if no source has it
+	[[nodiscard]] std::optional<size_t> layer_of(std::string_view key) const noexcept {
+		const auto e = this->find_opt(key);
+		if (e == nullptr)
+			return std::nullopt;
+		return layers[static_cast<size_t>(e - opts.data())];
+	}
+
+	[[nodiscard]] std::span<const std::basic_string_view<CharT>> args() const noexcept {
+		return a;
+	}
+
+private:
+	friend class detail::option_accessors<layered, CharT>;
+	friend struct detail::source_access;
+
+	using entry = detail::option_entry<CharT>;
+
+	struct candidate {
+		std::basic_string_view<CharT> key;
+		std::basic_string_view<CharT> value;
+		detail::converted_value conv;
+		std::span<const std::basic_string_view<CharT>> values;
+		size_t layer;
+	};
+
+	std::vector<entry> opts;
+	std::vector<detail::converted_value> conv;
+	std::vector<size_t> layers; /// provenance, same order as opts
+	std::vector<std::basic_string_view<CharT>> vals;
+	std::vector<detail::value_range> ranges;
+	std::span<const std::basic_string_view<CharT>> a;
+	detail::ascii_set shorts;
+
+	template <typename Source>
+	static void collect(const Source & source, size_t layer, std::vector<candidate> & all) {
+		static_assert(std::is_same_v<typename Source::char_type, CharT>, "all sources must have the same char type");
+		const auto entries = detail::source_access::entries(source);
+		const auto converted = detail::source_access::converted(source);
+		const auto values = detail::source_access::values(source);
+		const auto value_ranges = detail::source_access::value_ranges(source);
+		for (size_t i = 0; i < entries.size(); ++i) {
+			all.push_back({entries[i].first, entries[i].second, converted[i], values.subspan(value_ranges[i].first, value_ranges[i].count), layer});
+		}
+	}
+
+	std::span<const entry> entries() const noexcept {
+		return opts;
+	}
+
+	std::span<const detail::converted_value> converted() const noexcept {
+		return conv;
+	}
+
+	std::span<const std::basic_string_view<CharT>> values() const noexcept {
+		return vals;
+	}
+
+	std::span<const detail::value_range> value_ranges() const noexcept {
+		return ranges;
+	}
+
+	const detail::ascii_set & short_keys() const noexcept {
+		return shorts;
+	}
+};
+
+template <typename Source, typename... Sources>
+layered(const Source &, const Sources &...) -> layered<typename Source::char_type>;
 
 namespace detail {
-	inline std::optional<std::string> wstrtoutf8(const std::wstring_view & s);
+	/// string in the pool of a snapshot image, offset and length in chars
+	struct snapshot_string {
+		static constexpr std::uint32_t null_offset = 0xFFFFFFFF; /// null view, a bare flag
+
+		std::uint32_t offset;
+		std::uint32_t length;
+	};
+
+	enum snapshot_flags : std::uint8_t { snapshot_has_int = 1, snapshot_has_bool = 2, snapshot_bool_true = 4 };
+
+	/// key table entry, the converted values are stored so readers do not convert again
+	struct snapshot_key {
+		snapshot_string key;
+		snapshot_string value;
+		std::int32_t int_value;
+		std::uint8_t flags;
+		std::uint8_t reserved[3];
+		std::uint32_t values_first; /// repeated values, see value_range
+		std::uint32_t values_count;
+	};
+
+	/// followed by the key table, the argument table, the repeated value table and the pool
+	struct snapshot_header {
+		char magic[4];
+		std::uint32_t byte_order; /// snapshot_byte_order as written
+		std::uint16_t version;
+		std::uint16_t char_size;
+		std::uint32_t key_count;
+		std::uint32_t arg_count;
+		std::uint32_t value_count;
+		std::uint64_t pool_size; /// chars
+		std::uint64_t short_keys[2]; /// see ascii_set
+	};
+
+	inline constexpr char snapshot_magic[4] = {'Y', 'O', 'P', 'T'};
+	inline constexpr std::uint32_t snapshot_byte_order = 0x01020304;
+	inline constexpr std::uint16_t snapshot_version = 1;
+
+	/// byte offsets of the tables of an image
+	struct snapshot_layout {
+		size_t keys;
+		size_t args;
+		size_t values;
+		size_t pool;
+		size_t size;
+
+		template <typename CharT>
+		static constexpr snapshot_layout of(std::uint64_t key_count, std::uint64_t arg_count, std::uint64_t value_count, std::uint64_t pool_size) noexcept {
+			snapshot_layout l{};
+			l.keys = sizeof(snapshot_header);
+			l.args = l.keys + key_count * sizeof(snapshot_key);
+			l.values = l.args + arg_count * sizeof(snapshot_string);
+			l.pool = l.values + value_count * sizeof(snapshot_string);
+			l.size = l.pool + pool_size * sizeof(CharT);
+			return l;
+		}
+	};
 } //ns detail
 
+/// Relocatable binary image of parsed options: a header, the key table sorted like the source, tables of the
+/// free standing arguments and repeated values, and one pool with all key and value chars. Every value is
+/// stored once, the value of a key points at the pool string of its last repeated value. The image holds
+/// offsets only, so it can be written to a file or a memfd and read in place by basic_snapshot_view at any
+/// address, in any process of the same char size and byte order. Source is options, environment, layered or a
+/// parse_batch view.
+template <typename Source>
+[[nodiscard]] std::vector<std::byte> serialize(const Source & source) {
+	using CharT = typename Source::char_type;
+	const auto entries = detail::source_access::entries(source);
+	const auto converted = detail::source_access::converted(source);
+	const auto values = detail::source_access::values(source);
+	const auto value_ranges = detail::source_access::value_ranges(source);
+	const auto & args = source.args();
+
+	/// the value of a key with repeated values is the last of them, the key shares its pool string
+	const auto shared_value = [&](size_t i) -> std::optional<size_t> {
+		const auto & r = value_ranges[i];
+		if (r.count == 0)
+			return std::nullopt;
+		const auto last = r.first + r.count - 1;
+		const auto & v = entries[i].second;
+		if (values[last].data() != v.data() || values[last].size() != v.size())
+			return std::nullopt;
+		return last;
+	};
+
+	std::uint64_t pool_size = 0;
+	for (size_t i = 0; i < entries.size(); ++i) {
+		pool_size += entries[i].first.size();
+		if (!shared_value(i))
+			pool_size += entries[i].second.size();
+	}
+	for (const auto & v : values) {
+		pool_size += v.size();
+	}
+	for (const auto & v : args) {
+		pool_size += v.size();
+	}
+	if (pool_size >= detail::snapshot_string::null_offset)
+		throw std::length_error("options too large for a snapshot");
+
+	const auto layout = detail::snapshot_layout::of<CharT>(entries.size(), std::size(args), values.size(), pool_size);
+	std::vector<std::byte> image(layout.size);
+
+	detail::snapshot_header h{};
+	std::copy(std::begin(detail::snapshot_magic), std::end(detail::snapshot_magic), h.magic);
+	h.byte_order = detail::snapshot_byte_order;
+	h.version = detail::snapshot_version;
+	h.char_size = sizeof(CharT);
+	h.key_count = static_cast<std::uint32_t>(entries.size());
+	h.arg_count = static_cast<std::uint32_t>(std::size(args));
+	h.value_count = static_cast<std::uint32_t>(values.size());
+	h.pool_size = pool_size;
+	const auto & shorts = detail::source_access::short_keys(source);
+	h.short_keys[0] = shorts.bits[0];
+	h.short_keys[1] = shorts.bits[1];
+	std::memcpy(image.data(), &h, sizeof(h));
+
+	std::uint32_t pool_used = 0;
+	const auto put = [&](std::basic_string_view<CharT> s) {
+		if (s.data() == nullptr)
+			return detail::snapshot_string{detail::snapshot_string::null_offset, 0};
+		const detail::snapshot_string r{pool_used, static_cast<std::uint32_t>(s.size())};
+		std::memcpy(image.data() + layout.pool + pool_used * sizeof(CharT), s.data(), s.size() * sizeof(CharT));
+		pool_used += r.length;
+		return r;
+	};
+	for (size_t j = 0; j < values.size(); ++j) {
+		const auto r = put(values[j]);
+		std::memcpy(image.data() + layout.values + j * sizeof(r), &r, sizeof(r));
+	}
+	for (size_t i = 0; i < entries.size(); ++i) {
+		detail::snapshot_key k{};
+		k.key = put(entries[i].first);
+		if (const auto j = shared_value(i)) {
+			std::memcpy(&k.value, image.data() + layout.values + *j * sizeof(k.value), sizeof(k.value));
+		} else {
+			k.value = put(entries[i].second);
+		}
+		const auto & c = converted[i];
+		if (c.int_value) {
+			k.flags |= detail::snapshot_has_int;
+			k.int_value = *c.int_value;
+		}
+		if (c.bool_value)
+			k.flags |= detail::snapshot_has_bool | (*c.bool_value ? detail::snapshot_bool_true : 0);
+		k.values_first = static_cast<std::uint32_t>(value_ranges[i].first);
+		k.values_count = static_cast<std::uint32_t>(value_ranges[i].count);
+		std::memcpy(image.data() + layout.keys + i * sizeof(k), &k, sizeof(k));
+	}
+	size_t i = 0;
+	for (const auto & v : args) {
+		const auto r = put(v);
+		std::memcpy(image.data() + layout.args + i++ * sizeof(r), &r, sizeof(r));
+	}
+	return image;
+}
 
+/// Reader of an image written by serialize that answers queries in place: a lookup is a binary search over the
+/// key table of the image and converted ints and bools are read as stored, there is no deserialization step.
+/// Opening checks the header, the table sizes and every string and value range of the tables in one pass,
+/// so a corrupt image throws instead of being read out of bounds. A view over a span needs the image to
+/// outlive it, a view opened from a path keeps its mapping alive and is cheap to copy.
 template <typename CharT>
-class options {
+class basic_snapshot_view {
 public:
 	using char_type = CharT;
 
-	options(int argc, const CharT * const * argv) {
-		/// start from 1 - skip program name
-		for (int i = 1; i < argc; i++) {
-			parse(argv[i], true);
-		}
+	/// image at an address aligned to 8, e.g. a mmap of a file or memfd
+	explicit basic_snapshot_view(std::span<const std::byte> image) {
+		attach(image);
 	}
 
-	options(const CharT * cmd_line) {
-		parse(cmd_line);
+	/// maps the image file at path, e.g. written by a master process or /proc/self/fd/N of an inherited memfd
+	explicit basic_snapshot_view(const char * path) : file(std::make_shared<const detail::mapped_file>(path)) {
+		if (!file->is_open())
+			throw std::runtime_error("cannot map snapshot");
+		const auto bytes = file->chars<char>();
+		attach({reinterpret_cast<const std::byte *>(bytes.data()), bytes.size()});
 	}
 
-	[[nodiscard]] bool has_opt(std::string_view key) const {
-		return find_opt(key) != std::end(opts);
+	[[nodiscard]] bool has_opt(std::string_view key) const noexcept {
+		if (key.size() == 1 && static_cast<unsigned char>(key[0]) < 128)
+			return shorts.contains(key[0]);
+		return find(key) != nullptr;
 	}
 
-	[[nodiscard]] inline std::optional<std::basic_string_view<CharT>> get_native_string(std::string_view key) const noexcept {
-		const auto it = find_opt(key);
-		if (it == std::end(opts))
+	[[nodiscard]] std::optional<std::basic_string_view<CharT>> get_native_string(std::string_view key) const noexcept {
+		const auto k = find(key);
+		if (k == nullptr)
 			return std::nullopt;
-		return it->second;
+		return str(k->value);
 	}
 
-	[[nodiscard]] inline std::optional<std::string> get_string(std::string_view key) const noexcept;
+	[[nodiscard]] std::basic_string_view<CharT> get_native_string(std::string_view key, std::basic_string_view<CharT> default_value) const noexcept {
+		return get_native_string(key).value_or(default_value);
+	}
 
-	[[nodiscard]] inline std::basic_string_view<CharT> get_native_string(std::string_view key, std::basic_string_view<CharT> default_value) const noexcept {
+	[[nodiscard]] std::basic_string_view<CharT> get_required_native_string(std::string_view key) const {
 		const auto v = get_native_string(key);
-		if (!v)
-			return default_value;
+		if (!v.has_value())
+			throw std::out_of_range("option not provided");
 		return *v;
 	}
 
-	[[nodiscard]] inline std::basic_string_view<CharT> get_required_native_string(std::string_view key) const {
-		const auto v = get_native_string(key);
-		if (!v.has_value()) {
-			throw std::out_of_range("option not provided");
+	/// value as UTF-8 string
+	[[nodiscard]] std::optional<std::string> get_string(std::string_view key) const noexcept {
+		const auto s = get_native_string(key);
+		if (!s.has_value())
+			return std::nullopt;
+		if constexpr (std::is_same_v<CharT, char>) {
+			return std::string{*s};
+		} else {
+			return detail::wstrtoutf8(*s);
 		}
-		return v.value();
 	}
 
+	template <typename Vocabulary = bool_vocabulary>
 	[[nodiscard]] bool get_bool(std::string_view key, bool default_value = false) const {
-		const auto v = get_native_string(key);
-		if (!v)
+		const auto k = find(key);
+		if (k == nullptr)
 			return default_value;
-		const auto & s = v.value();
-		if (s.empty())
-			return true;
+		if constexpr (std::is_same_v<Vocabulary, bool_vocabulary>) {
+			if (k->flags & detail::snapshot_has_bool)
+				return (k->flags & detail::snapshot_bool_true) != 0;
+		} else {
+			if (const auto b = detail::convert_value<bool, Vocabulary>(str(k->value)))
+				return *b;
+		}
+		throw std::invalid_argument("boolean option argument not recognized");
+	}
 
-		static const std::unordered_set<std::basic_string<CharT>> true_values = {
-			make_string("TRUE"), make_string("true"), make_string("T"),
-			make_string("YES"), make_string("yes"), make_string("Y"), make_string("y"),
-			make_string("1")
-		};
+	[[nodiscard]] std::optional<int> get_int(std::string_view key) const noexcept {
+		const auto k = find(key);
+		if (k == nullptr || !(k->flags & detail::snapshot_has_int))
+			return std::nullopt;
+		return k->int_value;
+	}
 
-		/// initialization from rodata example
-		//static constexpr CharT true_value0[] = {'T','R','U','E'};
+	[[nodiscard]] int get_int(std::string_view key, int default_value) const noexcept {
+		return get_int(key).value_or(default_value);
+	}
 
-		//static const std::unordered_set<std::basic_string_view<CharT>> true_values {
-		//	make_string_view(true_value0)
-		//};
+	template <typename T>
+	[[nodiscard]] std::optional<T> get_number(std::string_view key) const noexcept {
+		static_assert(std::is_arithmetic_v<T> && !std::is_same_v<T, bool>, "use get_bool for booleans");
+		if constexpr (std::is_same_v<T, int>) {
+			return get_int(key);
+		} else {
+			const auto k = find(key);
+			if (k == nullptr)
+				return std::nullopt;
+			return detail::to_number<T>(str(k->value));
+		}
+	}
 
-		static const std::unordered_set<std::basic_string<CharT>> false_values = {
-			make_string("FALSE"), make_string("false"), make_string("F"),
-			make_string("NO"), make_string("no"), make_string("N"), make_string("n"),
-			make_string("0")
-		};
+	template <typename T>
+	[[nodiscard]] T get_number(std::string_view key, T default_value) const noexcept {
+		return get_number<T>(key).value_or(default_value);
+	}
 
-		if (true_values.find(std::basic_string<CharT>{s}) != std::end(true_values)) {
-			return true;
-		} else if (false_values.find(std::basic_string<CharT>{s}) != std::end(false_values)) {
-			return false;
+	/// see option_accessors::get_list
+	template <typename T = std::basic_string_view<CharT>>
+	[[nodiscard]] list_view<CharT, T> get_list(std::string_view key, CharT delimiter = ',') const noexcept {
+		const auto k = find(key);
+		if (k == nullptr)
+			return {};
+		return {str(k->value), delimiter};
+	}
+
+	/// number of values of a repeated option, see option_accessors::get_all
+	[[nodiscard]] size_t value_count(std::string_view key) const noexcept {
+		const auto k = find(key);
+		return k == nullptr ? 0 : k->values_count;
+	}
+
+	/// value at index of a repeated option in command line order
+	[[nodiscard]] std::basic_string_view<CharT> get_value(std::string_view key, size_t index) const {
+		const auto k = find(key);
+		if (k == nullptr || index >= k->values_count)
+			throw std::out_of_range("value index out of range");
+		return str(vals[k->values_first + index]);
+	}
+
+	/// free standing argument at index
+	[[nodiscard]] std::basic_string_view<CharT> arg(size_t index) const {
+		if (index >= arg_count())
+			throw std::out_of_range("argument index out of range");
+		return str(argv[index]);
+	}
+
+	[[nodiscard]] size_t arg_count() const noexcept {
+		return header->arg_count;
+	}
+
+private:
+	std::shared_ptr<const detail::mapped_file> file;
+	const detail::snapshot_header * header = nullptr;
+	const detail::snapshot_key * keys = nullptr;
+	const detail::snapshot_string * argv = nullptr;
+	const detail::snapshot_string * vals = nullptr;
+	const CharT * pool = nullptr;
+	detail::ascii_set shorts;
+
+	void attach(std::span<const std::byte> image) {
+		if (image.size() < sizeof(detail::snapshot_header) || reinterpret_cast<std::uintptr_t>(image.data()) % alignof(detail::snapshot_header) != 0)
+			throw std::invalid_argument("not a snapshot image");
+		header = reinterpret_cast<const detail::snapshot_header *>(image.data());
+		if (!std::equal(std::begin(detail::snapshot_magic), std::end(detail::snapshot_magic), header->magic)
+			|| header->byte_order != detail::snapshot_byte_order || header->version != detail::snapshot_version)
+			throw std::invalid_argument("not a snapshot image");
+		if (header->char_size != sizeof(CharT))
+			throw std::invalid_argument("snapshot of another char type");
+		const auto layout = detail::snapshot_layout::of<CharT>(header->key_count, header->arg_count, header->value_count, header->pool_size);
+		if (header->pool_size >= detail::snapshot_string::null_offset || layout.size != image.size())
+			throw std::invalid_argument("truncated snapshot image");
+		keys = reinterpret_cast<const detail::snapshot_key *>(image.data() + layout.keys);
+		argv = reinterpret_cast<const detail::snapshot_string *>(image.data() + layout.args);
+		vals = reinterpret_cast<const detail::snapshot_string *>(image.data() + layout.values);
+		pool = reinterpret_cast<const CharT *>(image.data() + layout.pool);
+		shorts.bits[0] = header->short_keys[0];
+		shorts.bits[1] = header->short_keys[1];
+		validate();
+	}
+
+	/// every string lies in the pool and every value range in the value table
+	void validate() const {
+		const auto valid = [this](const detail::snapshot_string & s, bool may_be_null) {
+			if (s.offset == detail::snapshot_string::null_offset)
+				return may_be_null && s.length == 0;
+			return std::uint64_t{s.offset} + s.length <= header->pool_size;
+		};
+		for (size_t i = 0; i < header->key_count; ++i) {
+			const auto & k = keys[i];
+			if (!valid(k.key, false) || !valid(k.value, true)
+				|| std::uint64_t{k.values_first} + k.values_count > header->value_count)
+				throw std::invalid_argument("corrupt snapshot image");
+		}
+		for (size_t i = 0; i < header->arg_count; ++i) {
+			if (!valid(argv[i], false))
+				throw std::invalid_argument("corrupt snapshot image");
+		}
+		for (size_t i = 0; i < header->value_count; ++i) {
+			if (!valid(vals[i], false))
+				throw std::invalid_argument("corrupt snapshot image");
 		}
+	}
 
-		throw std::invalid_argument("boolean option argument not recognized");
+	std::basic_string_view<CharT> str(const detail::snapshot_string & s) const noexcept {
+		if (s.offset == detail::snapshot_string::null_offset)
+			return {};
+		return {pool + s.offset, s.length};
 	}
 
-	[[nodiscard]] inline std::optional<int> get_int(std::string_view key) const noexcept {
-		const auto v = get_string(key);
-		if (!v)
-			return std::nullopt;
-		const auto & sv = v.value();
-		int value = 0;
-		std::from_chars_result r;
-		r = std::from_chars(sv.data(), sv.data() + sv.size(), value);
-		if (r.ec == std::errc())
-			return value;
-		return std::nullopt;
+	const detail::snapshot_key * find(std::string_view key) const noexcept {
+		const auto end = keys + header->key_count;
+		const auto it = std::lower_bound(keys, end, key, [this](const detail::snapshot_key & k, std::string_view key) {
+			return detail::compare_key(str(k.key), key) < 0;
+		});
+		if (it != end && detail::compare_key(str(it->key), key) == 0)
+			return it;
+		return nullptr;
 	}
+};
 
-	[[nodiscard]] int get_int(std::string_view key, int default_value) const noexcept {
-		const auto opt_value = get_int(key);
-		return opt_value.value_or(default_value);
+using snapshot_view = basic_snapshot_view<char>;
+using wsnapshot_view = basic_snapshot_view<wchar_t>;
+
+/// NULL terminated argv for execve or posix_spawn, the pointer array and all strings share one allocation.
+template <typename CharT>
+class basic_argv {
+public:
+	[[nodiscard]] CharT * const * data() const noexcept {
+		return reinterpret_cast<CharT * const *>(block.get());
 	}
 
-	/// free standing argument at index
-	[[nodiscard]] inline const std::basic_string_view<CharT> arg(size_t index) const {
-		return a.at(index);
+	/// arguments, the terminating null pointer not counted
+	[[nodiscard]] size_t size() const noexcept {
+		return count;
 	}
 
-	[[nodiscard]] inline auto arg_count() const noexcept {
-		return a.size();
+	[[nodiscard]] const CharT * operator[](size_t index) const noexcept {
+		return data()[index];
 	}
 
-	[[nodiscard]] inline const std::vector<std::basic_string_view<CharT>> & args() const noexcept {
-		return a;
+private:
+	template <typename> friend class basic_command_builder;
+
+	std::unique_ptr<std::byte[]> block;
+	size_t count = 0;
+};
+
+/// Turns parsed options back into a command line string or an argv, with some options changed, e.g. to spawn
+/// children with the options of the parent. Options are emitted as --key or --key=value in key order, every value
+/// of a repeated option (see get_all) once, followed by the free standing arguments. Quoting follows what parse()
+/// accepts, a value that cannot be quoted for it (a quote inside a value that needs quotes) throws
+/// std::invalid_argument. The source and the override values must outlive the builder.
+template <typename CharT>
+class basic_command_builder {
+public:
+	using char_type = CharT;
+
+	template <typename Source>
+	explicit basic_command_builder(const Source & source)
+		: entries(detail::source_access::entries(source)), values(detail::source_access::values(source)),
+		  ranges(detail::source_access::value_ranges(source)), a(std::data(source.args()), std::size(source.args())) {}
+
+	/// replaces all values of key, or adds it
+	basic_command_builder & set(std::string_view key, std::basic_string_view<CharT> value) {
+		change_of(key) = {value, true};
+		return *this;
+	}
+
+	/// key becomes a bare flag
+	basic_command_builder & set_flag(std::string_view key) {
+		change_of(key) = {std::basic_string_view<CharT>{}, true};
+		return *this;
+	}
+
+	basic_command_builder & remove(std::string_view key) {
+		change_of(key) = {std::basic_string_view<CharT>{}, false};
+		return *this;
+	}
+
+	/// space separated command line for options(const CharT *), sized before it is written
+	[[nodiscard]] std::basic_string<CharT> command_line() const {
+		size_t size = 0;
+		for_each_token([&](bool is_arg, std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+			size += (size ? 1 : 0) + token_size(false, is_arg, key, value);
+		});
+		std::basic_string<CharT> res;
+		res.reserve(size);
+		for_each_token([&](bool is_arg, std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+			if (!res.empty())
+				res.push_back(' ');
+			const auto at = res.size();
+			res.resize(at + token_size(false, is_arg, key, value));
+			write_token(false, is_arg, key, value, res.data() + at);
+		});
+		return res;
+	}
+
+	/// argv for options(argc, argv) with program as argv[0], one allocation holds the pointers and the strings
+	[[nodiscard]] basic_argv<CharT> argv(std::basic_string_view<CharT> program) const {
+		size_t count = 1;
+		size_t chars = program.size() + 1;
+		for_each_token([&](bool is_arg, std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+			++count;
+			chars += token_size(true, is_arg, key, value) + 1;
+		});
+		basic_argv<CharT> res;
+		res.count = count;
+		res.block = std::make_unique<std::byte[]>((count + 1) * sizeof(CharT *) + chars * sizeof(CharT));
+		auto pointers = reinterpret_cast<CharT **>(res.block.get());
+		auto out = reinterpret_cast<CharT *>(res.block.get() + (count + 1) * sizeof(CharT *));
+		*pointers++ = out;
+		out = std::copy(std::begin(program), std::end(program), out);
+		*out++ = CharT{};
+		for_each_token([&](bool is_arg, std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+			*pointers++ = out;
+			out = write_token(true, is_arg, key, value, out);
+			*out++ = CharT{};
+		});
+		*pointers = nullptr;
+		return res;
 	}
 
 private:
-	enum class parse_state { none, key_prefix, long_key_prefix, key, value, quoted_value };
+	struct change_value {
+		std::basic_string_view<CharT> value; /// null for a bare flag
+		bool keep = true; /// false - removed
+	};
 
-	std::vector<std::basic_string_view<CharT>> a; /// free standing values
-	std::map<std::basic_string_view<CharT>, std::basic_string_view<CharT>> opts; /// parsed key values
+	struct change {
+		std::basic_string<CharT> key;
+		change_value v;
+	};
 
-	void parse(const CharT * s, bool single_value = false) {
-		auto ps = parse_state::none;
+	std::span<const detail::option_entry<CharT>> entries;
+	std::span<const std::basic_string_view<CharT>> values;
+	std::span<const detail::value_range> ranges;
+	std::span<const std::basic_string_view<CharT>> a;
+	std::vector<change> changes;
 
-		const CharT * c = s;
-		const CharT * token_start = c;
+	change_value & change_of(std::string_view key) {
+		for (auto & c : changes) {
+			if (detail::compare_key(std::basic_string_view<CharT>{c.key}, key) == 0)
+				return c.v;
+		}
+		changes.push_back({std::basic_string<CharT>(std::begin(key), std::end(key)), {}});
+		return changes.back().v;
+	}
 
-		std::basic_string_view<CharT> key;
+	const change_value * find_change(std::basic_string_view<CharT> key) const noexcept {
+		for (const auto & c : changes) {
+			if (c.key == key)
+				return &c.v;
+		}
+		return nullptr;
+	}
 
-		size_t len = 0;
-		while (len < max_length) {
-			switch (ps) {
-				case parse_state::none:
-					if (is_whitespace(*c)) {
-						/// skip
-					} else if (is_dash(*c)) {
-						ps = parse_state::key_prefix;
-						if (key.size() > 0)
-							opts[key];
-					} else if (is_quote(*c)) {
-						ps = parse_state::quoted_value;
-						token_start = c;
-					} else {
-						ps = parse_state::value;
-						token_start = c;
-					}
-					break;
-				case parse_state::key_prefix:
-					if (is_dash(*c)) {
-						ps = parse_state::long_key_prefix;
-					} else if (is_whitespace(*c)) {
-						ps = parse_state::none;
-					} else {
-						ps = parse_state::key;
-						token_start = c;
-					}
-					break;
-				case parse_state::long_key_prefix:
-					if (is_whitespace(*c)) {
-						ps = parse_state::none;
-					} else {
-						ps = parse_state::key;
-						token_start = c;
-					}
-					break;
-				case parse_state::key:
-					if (is_whitespace(*c)) {
-						ps = parse_state::none;
-						if (c > token_start) {
-							opts[{token_start, c}];
-						}
-					} else if (is_equal_sign(*c)) {
-						ps = parse_state::value;
-						key = {token_start, c};
-						token_start = c + 1;
-					}
-					break;
-				case parse_state::value:
-					if (is_quote(*c) && token_start == c) {
-						ps = parse_state::quoted_value;
-					} else if (is_whitespace(*c) && !single_value) {
-						ps = parse_state::none;
-						if (key.size() > 0) {
-							opts[key] = {token_start, c};
-						} else {
-							a.emplace_back(token_start, c);
-						}
-						key = {};
-					}
-					break;
-				case parse_state::quoted_value:
-					if (is_quote(*c)) {
-						ps = parse_state::none;
-						if (key.size() > 0) {
-							opts[key] = {token_start + 1, c};
-						} else {
-							a.emplace_back(token_start + 1, c);
-						}
-						key = {};
-					}
-			}
-			if (is_eol(*c)) {
-				/// handle trailing tokens
-				if (ps == parse_state::key && token_start < c) {
-					key = {token_start, c};
-					opts[key];
-				} else if (ps == parse_state::value) {
-					if (key.size() > 0) {
-						opts[key] = {token_start, c};
-					} else if (c > token_start) { /// store only non empty free standing arguments
-						a.emplace_back(token_start, c);
-					}
-				} else if (ps == parse_state::quoted_value) {
-					if (key.size() > 0) {
-						opts[key] = {token_start + 1, c};
-					} else {
-						a.emplace_back(token_start + 1, c);
-					}
-				}
-				break;
+	bool in_source(std::basic_string_view<CharT> key) const noexcept {
+		const auto it = std::lower_bound(std::begin(entries), std::end(entries), key, [](const auto & e, std::basic_string_view<CharT> k) {
+			return e.first < k;
+		});
+		return it != std::end(entries) && it->first == key;
+	}
+
+	/// f(is_arg, key, value) for every option value and argument in output order
+	template <typename F>
+	void for_each_token(F && f) const {
+		for (size_t i = 0; i < entries.size(); ++i) {
+			const auto key = entries[i].first;
+			if (const auto c = find_change(key)) {
+				if (c->keep)
+					f(false, key, c->value);
+			} else if (ranges[i].count == 0) {
+				f(false, key, std::basic_string_view<CharT>{});
+			} else {
+				for (const auto & v : values.subspan(ranges[i].first, ranges[i].count))
+					f(false, key, v);
 			}
-			c++;
-			len++;
 		}
+		for (const auto & c : changes) {
+			if (c.v.keep && !in_source(c.key))
+				f(false, std::basic_string_view<CharT>{c.key}, c.v.value);
+		}
+		for (const auto & v : a)
+			f(true, std::basic_string_view<CharT>{}, v);
+	}
+
+	/// Whether s must be quoted, throws if parse() could not read it back.
+	/// single_value - an argv entry, whitespace does not end a value there
+	static bool needs_quotes(bool single_value, bool is_arg, std::basic_string_view<CharT> s) {
+		bool quote = !s.empty() && detail::is_quote(s[0]);
+		if (is_arg)
+			quote = quote || s.empty() || detail::is_dash(s[0]) || s[0] == '@';
+		if (!single_value)
+			quote = quote || std::any_of(std::begin(s), std::end(s), [](CharT c) { return detail::is_whitespace(c); });
+		if (quote && std::any_of(std::begin(s), std::end(s), [](CharT c) { return detail::is_quote(c); }))
+			throw std::invalid_argument("value cannot be quoted");
+		return quote;
+	}
+
+	static size_t token_size(bool single_value, bool is_arg, std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+		const auto quoted = value.size() + (needs_quotes(single_value, is_arg, value) ? 2 : 0);
+		if (is_arg)
+			return quoted;
+		if (key.empty() || std::any_of(std::begin(key), std::end(key), [](CharT c) { return detail::is_whitespace(c) || detail::is_equal_sign(c); }))
+			throw std::invalid_argument("option name cannot be written");
+		return 2 + key.size() + (value.data() ? 1 + quoted : 0);
+	}
+
+	static CharT * write_token(bool single_value, bool is_arg, std::basic_string_view<CharT> key, std::basic_string_view<CharT> value, CharT * out) {
+		if (!is_arg) {
+			*out++ = '-';
+			*out++ = '-';
+			out = std::copy(std::begin(key), std::end(key), out);
+			if (!value.data())
+				return out;
+			*out++ = '=';
+		}
+		const auto quote = needs_quotes(single_value, is_arg, value);
+		if (quote)
+			*out++ = '"';
+		out = std::copy(std::begin(value), std::end(value), out);
+		if (quote)
+			*out++ = '"';
+		return out;
+	}
+};
+
+template <typename Source>
+basic_command_builder(const Source &) -> basic_command_builder<typename Source::char_type>;
+
+using command_builder = basic_command_builder<char>;
+using wcommand_builder = basic_command_builder<wchar_t>;
+
+namespace pmr {
+	/// options drawing all internal storage from a std::pmr::memory_resource, e.g. a monotonic arena
+	template <typename CharT>
+	using options = yopt::options<CharT, std::pmr::polymorphic_allocator<CharT>>;
+} //ns pmr
+
+/// string literal usable as a template argument, e.g. opt<"threads", int>
+template <size_t N>
+struct fixed_string {
+	char value[N]{};
+
+	constexpr fixed_string(const char (& s)[N]) {
+		for (size_t i = 0; i < N; ++i) {
+			value[i] = s[i];
+		}
+	}
+
+	constexpr std::string_view view() const noexcept {
+		return {value, N - 1};
+	}
+};
+
+/// schema entry: option name and value type (bool, arithmetic or native string view)
+template <fixed_string Name, typename T>
+struct opt {
+	static constexpr std::string_view name = Name.view();
+	using type = T;
+};
+
+namespace detail {
+	/// value slot I of a schema
+	template <size_t I, typename T>
+	struct schema_slot {
+		std::optional<T> value;
+	};
+
+	/// One base per option. Slot I is found by derived to base conversion, which stays O(1) per
+	/// access for hundreds of options, unlike the recursive std::get of a std::tuple.
+	template <typename Seq, typename... Ts>
+	struct schema_slots;
+
+	template <size_t... I, typename... Ts>
+	struct schema_slots<std::index_sequence<I...>, Ts...> : schema_slot<I, Ts>... {};
+
+	template <size_t I, typename T>
+	constexpr std::optional<T> & slot_at(schema_slot<I, T> & s) noexcept {
+		return s.value;
+	}
+
+	template <size_t I, typename T>
+	constexpr const std::optional<T> & slot_at(const schema_slot<I, T> & s) noexcept {
+		return s.value;
+	}
+} //ns detail
+
+/// Command line parsed against a fixed set of options.
+/// Names map to dense indices through a perfect hash built at compile time, so parsing finds the slot of
+/// a key with one probe and one compare. Values are converted once while parsing and get<"name">() is a
+/// load from a fixed slot. Unknown options are ignored.
+/// A single char option that is not bool takes the next argument as its value when it ends a short
+/// option cluster without =value, e.g. -vn 4 or argv {"-n", "4"}.
+template <typename CharT, typename... Opts>
+class basic_schema {
+public:
+	using char_type = CharT;
+
+	static constexpr size_t size = sizeof...(Opts);
+
+	basic_schema(int argc, const CharT * const * argv) {
+		/// start from 1 - skip program name
+		for (int i = 1; i < argc; i++) {
+			parse(argv[i], argv[i] + std::char_traits<CharT>::length(argv[i]), true);
+		}
+		flush_pending();
 	}
 
-	static constexpr bool is_eol(CharT c) {
-		return c == '\0';
+	basic_schema(const CharT * cmd_line) {
+		parse(cmd_line, cmd_line + std::min(std::char_traits<CharT>::length(cmd_line), max_length));
+		flush_pending();
 	}
 
-	static constexpr bool is_whitespace(CharT c) {
-		return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+	basic_schema(std::basic_string_view<CharT> cmd_line) {
+		parse(cmd_line.data(), cmd_line.data() + cmd_line.size());
+		flush_pending();
 	}
 
-	static constexpr bool is_dash(CharT c) {
-		return (c == '-');
+	static constexpr std::array<std::string_view, size> names = {Opts::name...};
+
+	/// index of an option name, size if not part of the schema
+	static constexpr size_t index_of(std::string_view name) noexcept {
+		return runtime_index(name);
 	}
 
-	static constexpr bool is_quote(CharT c) {
-		return (c == '"');
+	template <fixed_string Name>
+	[[nodiscard]] const auto & get() const noexcept {
+		constexpr auto index = index_of(Name.view());
+		static_assert(index < size, "option is not part of the schema");
+		return detail::slot_at<index>(values);
 	}
 
-	static constexpr bool is_equal_sign(CharT c) {
-		return (c == '=');
+	template <fixed_string Name, typename T>
+	[[nodiscard]] auto get(T && default_value) const {
+		return get<Name>().value_or(std::forward<T>(default_value));
 	}
 
-	static inline constexpr std::basic_string<CharT> make_string(const char * s) {
-		size_t len = 0;
-		const auto * const str = s;
-		while (*s++) {
-			++len;
-		}
-		std::basic_string<CharT> result(len, 0);
-		for (size_t i = 0; i < len; ++i) {
-			result[i] = str[i];
-		}
-		return result;
+	template <fixed_string Name>
+	[[nodiscard]] bool has() const noexcept {
+		return get<Name>().has_value();
 	}
 
-	auto find_opt(std::string_view key) const;
-};
+	/// free standing argument at index
+	[[nodiscard]] inline const std::basic_string_view<CharT> arg(size_t index) const {
+		return a.at(index);
+	}
 
-template <>
-inline auto options<wchar_t>::find_opt(std::string_view key) const {
-	const std::wstring wkey{std::begin(key), std::end(key)};
-	return opts.find(wkey);
-}
+	[[nodiscard]] inline auto arg_count() const noexcept {
+		return a.size();
+	}
 
-template <>
-inline auto options<char>::find_opt(std::string_view key) const {
-	return opts.find(key);
-}
+	[[nodiscard]] inline const std::vector<std::basic_string_view<CharT>> & args() const noexcept {
+		return a;
+	}
 
-template <>
-[[nodiscard]] inline std::optional<std::string> options<char>::get_string(std::string_view key) const noexcept {
-	const auto s = get_native_string(key);
-	if (s.has_value()) {
-		return std::string{s.value()};
+private:
+	static constexpr bool unique_names() {
+		auto sorted = names;
+		std::sort(sorted.begin(), sorted.end());
+		return std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
 	}
-	return std::nullopt;
-}
+	static_assert(unique_names(), "duplicate option name in schema");
+
+	static constexpr detail::perfect_hash<CharT, size> hash{names};
 
-template <>
-[[nodiscard]] inline std::optional<std::string> options<wchar_t>::get_string(std::string_view key) const noexcept {
-	const auto s = get_native_string(key);
-	if (s.has_value()) {
-		return detail::wstrtoutf8(s.value());
+	/// single char options that take the following argument as value
+	static constexpr std::array<bool, size> takes_next = {(Opts::name.size() == 1 && !std::is_same_v<typename Opts::type, bool>)...};
+
+	detail::schema_slots<std::index_sequence_for<Opts...>, typename Opts::type...> values;
+	std::vector<std::basic_string_view<CharT>> a; /// free standing values
+	size_t pending = size; /// short option waiting for the next argument
+
+	/// one perfect hash probe and at most one name compare, unknown keys are rejected by that compare
+	template <typename KeyChar>
+	static constexpr size_t runtime_index(std::basic_string_view<KeyChar> key) noexcept {
+		if constexpr (size == 0) {
+			return size;
+		} else {
+			const auto i = hash.candidate(key);
+			const auto & name = names[i];
+			if (key.size() != name.size())
+				return size;
+			if constexpr (std::is_same_v<KeyChar, char>) {
+				return key == name ? i : size;
+			} else {
+				return detail::compare_key(key, name) == 0 ? i : size;
+			}
+		}
 	}
-	return std::nullopt;
-}
 
-template <typename CharT>
-inline std::basic_string_view<CharT> strip_quotes(const std::basic_string_view<CharT> & s) {
-	auto b = cbegin(s);
-	if (*b == '"' && b != end(s))
-		++b;
-	auto e = cend(s);
-	if (e != b) {
-		--e;
-		if (*e == '"' && e != b) {
-			--e;
+	template <size_t I>
+	void assign(std::basic_string_view<CharT> value) {
+		auto & slot = detail::slot_at<I>(values);
+		/// a bare flag does not override an earlier value
+		if (value.data() == nullptr && slot.has_value())
+			return;
+		using T = typename std::remove_reference_t<decltype(slot)>::value_type;
+		slot = detail::convert_value<T>(value);
+		if (!slot.has_value())
+			throw std::invalid_argument("option argument not recognized");
+	}
+
+	void assign_at(size_t index, std::basic_string_view<CharT> value) {
+		/// slot index -> conversion into that slot
+		static constexpr auto assigners = []<size_t... I>(std::index_sequence<I...>) {
+			return std::array<void (basic_schema::*)(std::basic_string_view<CharT>), size>{&basic_schema::template assign<I>...};
+		}(std::index_sequence_for<Opts...>{});
+		(this->*assigners[index])(value);
+	}
+
+	/// a pending short option without a following argument is a bare flag
+	void flush_pending() {
+		if (pending < size) {
+			const auto index = pending;
+			pending = size;
+			assign_at(index, {});
 		}
 	}
-	return std::basic_string_view<CharT>{b, e+1};
-}
+
+	void parse(const CharT * s, const CharT * end, bool single_value = false) {
+		struct collector {
+			basic_schema & o;
+
+			void on_option(std::basic_string_view<CharT> key, std::basic_string_view<CharT> value) {
+				o.flush_pending();
+				const auto index = runtime_index(key);
+				if (index < size)
+					o.assign_at(index, value);
+			}
+
+			void on_short_options(std::basic_string_view<CharT> cluster, std::basic_string_view<CharT> value) {
+				if (cluster.empty())
+					return on_option(cluster, value);
+				for (size_t i = 0; i + 1 < cluster.size(); ++i)
+					on_option(cluster.substr(i, 1), std::basic_string_view<CharT>{});
+				const auto last = cluster.substr(cluster.size() - 1);
+				const auto index = runtime_index(last);
+				if (value.data() == nullptr && index < size && takes_next[index]) {
+					o.flush_pending();
+					o.pending = index;
+				} else {
+					on_option(last, value);
+				}
+			}
+
+			void on_arg(std::basic_string_view<CharT> value) {
+				if (o.pending < size) {
+					const auto index = o.pending;
+					o.pending = size;
+					o.assign_at(index, value);
+				} else {
+					o.a.emplace_back(value);
+				}
+			}
+		};
+		detail::tokenize(s, end, single_value, collector{*this});
+	}
+};
+
+template <typename... Opts>
+using schema = basic_schema<char, Opts...>;
+
+template <typename... Opts>
+using wschema = basic_schema<wchar_t, Opts...>;
 
 namespace detail {
 
@@ -345,8 +2881,193 @@ inline std::optional<std::string> wstrtoutf8(const std::wstring_view & s) {
 		return std::nullopt;
 	return res;
 }
+#else
+/// Decodes one code point (UTF-16 or UTF-32 depending on sizeof(wchar_t)), returns units consumed or 0 if invalid.
+inline size_t decode_wide(const wchar_t * p, const wchar_t * end, char32_t & cp) noexcept {
+	if constexpr (sizeof(wchar_t) == 2) {
+		const char32_t u = static_cast<std::uint16_t>(p[0]);
+		if (u < 0xD800 || u > 0xDFFF) {
+			cp = u;
+			return 1;
+		}
+		if (u > 0xDBFF || end - p < 2)
+			return 0;
+		const char32_t l = static_cast<std::uint16_t>(p[1]);
+		if (l < 0xDC00 || l > 0xDFFF)
+			return 0;
+		cp = 0x10000 + ((u - 0xD800) << 10) + (l - 0xDC00);
+		return 2;
+	} else {
+		cp = static_cast<char32_t>(p[0]);
+		if (cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+			return 0;
+		return 1;
+	}
+}
+
+inline constexpr size_t utf8_size(char32_t cp) noexcept {
+	return cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+}
+
+inline char * encode_utf8(char32_t cp, char * out) noexcept {
+	if (cp < 0x80) {
+		*out++ = static_cast<char>(cp);
+	} else if (cp < 0x800) {
+		*out++ = static_cast<char>(0xC0 | (cp >> 6));
+		*out++ = static_cast<char>(0x80 | (cp & 0x3F));
+	} else if (cp < 0x10000) {
+		*out++ = static_cast<char>(0xE0 | (cp >> 12));
+		*out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		*out++ = static_cast<char>(0x80 | (cp & 0x3F));
+	} else {
+		*out++ = static_cast<char>(0xF0 | (cp >> 18));
+		*out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+		*out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		*out++ = static_cast<char>(0x80 | (cp & 0x3F));
+	}
+	return out;
+}
+
+/// ASCII fast path: true if the 16 code units at p are all ASCII, they are narrowed to out unless it is null.
+inline bool ascii_block(const wchar_t * p, char * out) noexcept {
+#if defined YOPT_SSE2
+	const auto * v = reinterpret_cast<const __m128i *>(p);
+	__m128i narrow;
+	if constexpr (sizeof(wchar_t) == 2) {
+		const __m128i a = _mm_loadu_si128(v);
+		const __m128i b = _mm_loadu_si128(v + 1);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(a, b), _mm_set1_epi16(-0x80)), _mm_setzero_si128())) != 0xFFFF)
+			return false;
+		narrow = _mm_packus_epi16(a, b);
+	} else {
+		const __m128i a = _mm_loadu_si128(v);
+		const __m128i b = _mm_loadu_si128(v + 1);
+		const __m128i c = _mm_loadu_si128(v + 2);
+		const __m128i d = _mm_loadu_si128(v + 3);
+		const __m128i any = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(any, _mm_set1_epi32(-0x80)), _mm_setzero_si128())) != 0xFFFF)
+			return false;
+		narrow = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+	}
+	if (out)
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out), narrow);
+	return true;
+#else
+	for (size_t i = 0; i < 16; ++i) {
+		if (static_cast<std::make_unsigned_t<wchar_t>>(p[i]) > 0x7F)
+			return false;
+	}
+	if (out) {
+		for (size_t i = 0; i < 16; ++i) {
+			out[i] = static_cast<char>(p[i]);
+		}
+	}
+	return true;
+#endif
+}
+
+/// Portable UTF-16/UTF-32 to UTF-8 transcoder, invalid code units (lone surrogates, out of range values) yield nullopt.
+/// Validates and sizes the output first, so the result is allocated exactly once.
+inline std::optional<std::string> wstrtoutf8(const std::wstring_view & s) {
+	const wchar_t * const end = s.data() + s.size();
+	size_t size = 0;
+	for (const wchar_t * p = s.data(); p != end;) {
+		if (end - p >= 16 && ascii_block(p, nullptr)) {
+			p += 16;
+			size += 16;
+			continue;
+		}
+		char32_t cp;
+		const auto n = decode_wide(p, end, cp);
+		if (n == 0)
+			return std::nullopt;
+		p += n;
+		size += utf8_size(cp);
+	}
+
+	std::string res(size, '\0');
+	char * out = res.data();
+	for (const wchar_t * p = s.data(); p != end;) {
+		if (end - p >= 16 && ascii_block(p, out)) {
+			p += 16;
+			out += 16;
+			continue;
+		}
+		char32_t cp;
+		p += decode_wide(p, end, cp);
+		out = encode_utf8(cp, out);
+	}
+	return res;
+}
 #endif
 
+/// Decodes one UTF-8 sequence, returns bytes consumed or 0 if invalid (truncated, overlong, surrogate, out of range).
+inline size_t decode_utf8(const char * p, const char * end, char32_t & cp) noexcept {
+	const auto lead = static_cast<unsigned char>(p[0]);
+	size_t n;
+	char32_t min;
+	if (lead < 0x80) {
+		cp = lead;
+		return 1;
+	} else if ((lead & 0xE0) == 0xC0) {
+		n = 2;
+		cp = lead & 0x1F;
+		min = 0x80;
+	} else if ((lead & 0xF0) == 0xE0) {
+		n = 3;
+		cp = lead & 0x0F;
+		min = 0x800;
+	} else if ((lead & 0xF8) == 0xF0) {
+		n = 4;
+		cp = lead & 0x07;
+		min = 0x10000;
+	} else {
+		return 0;
+	}
+	if (static_cast<size_t>(end - p) < n)
+		return 0;
+	for (size_t i = 1; i < n; ++i) {
+		const auto b = static_cast<unsigned char>(p[i]);
+		if ((b & 0xC0) != 0x80)
+			return 0;
+		cp = (cp << 6) | (b & 0x3F);
+	}
+	if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+		return 0;
+	return n;
+}
+
+/// Portable UTF-8 to UTF-16/UTF-32 transcoder appending to out, a container of wchar_t. False on invalid UTF-8.
+/// Validates and sizes the output first, so out grows once.
+template <typename Out>
+bool utf8towstr(std::string_view s, Out & out) {
+	const char * const end = s.data() + s.size();
+	size_t size = 0;
+	for (const char * p = s.data(); p != end;) {
+		char32_t cp;
+		const auto n = decode_utf8(p, end, cp);
+		if (n == 0)
+			return false;
+		p += n;
+		size += (sizeof(wchar_t) == 2 && cp > 0xFFFF) ? 2 : 1;
+	}
+
+	out.reserve(out.size() + size);
+	for (const char * p = s.data(); p != end;) {
+		char32_t cp = 0;
+		p += decode_utf8(p, end, cp);
+		if constexpr (sizeof(wchar_t) == 2) {
+			if (cp > 0xFFFF) {
+				out.push_back(static_cast<wchar_t>(0xD800 + ((cp - 0x10000) >> 10)));
+				out.push_back(static_cast<wchar_t>(0xDC00 + ((cp - 0x10000) & 0x3FF)));
+				continue;
+			}
+		}
+		out.push_back(static_cast<wchar_t>(cp));
+	}
+	return true;
+}
+
 } //ns yopt::detail
 
 } //ns yopt
@@ -357,6 +3078,8 @@ inline std::optional<std::string> wstrtoutf8(const std::wstring_view & s) {
 #ifndef DOCTEST_LIBRARY_INCLUDED
 #include <doctest.h>
 #endif
+#include <filesystem>
+#include <fstream>
 
 TEST_CASE("options wchar_t") {
 	const wchar_t command_line[] = L"--first-option --second-option=value \"first quoted argument\"";
@@ -374,6 +3097,28 @@ TEST_CASE("options wchar_t") {
 	CHECK(o.get_native_string("second-option").value() == L"value");
 }
 
+TEST_CASE("options wchar_t lookup") {
+	yopt::options o{L"--beta=2 --alpha=1 --gamma --alp"};
+	CHECK(o.get_native_string("alpha").value() == L"1");
+	CHECK(o.get_native_string("beta").value() == L"2");
+	CHECK(o.has_opt("gamma"));
+	CHECK(o.has_opt("alp"));
+	CHECK(o.has_opt("al") == false);
+	CHECK(o.has_opt("alphabet") == false);
+	CHECK(o.has_opt("") == false);
+}
+
+TEST_CASE("options wchar_t utf8") {
+	CHECK(yopt::detail::wstrtoutf8(L"").value() == "");
+	CHECK(yopt::detail::wstrtoutf8(L"plain ascii text that spans several blocks of sixteen").value() == "plain ascii text that spans several blocks of sixteen");
+	CHECK(yopt::detail::wstrtoutf8(L"0123456789abcdef\u00e9\u20ac\U0001F600 tail").value() == "0123456789abcdef\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80 tail");
+	const wchar_t lone_surrogate[] = {L'a', static_cast<wchar_t>(0xD800), L'b', 0};
+	CHECK(yopt::detail::wstrtoutf8(lone_surrogate).has_value() == false);
+
+	yopt::options o{L"--name=caf\u00e9"};
+	CHECK(o.get_string("name").value() == "caf\xC3\xA9");
+}
+
 TEST_CASE("options bool") {
 	const char true_cmd[] = "--bool0 --bool1=TRUE --bool2=Y --bool3=1";
 	yopt::options to{true_cmd};
@@ -392,12 +3137,797 @@ TEST_CASE("options bool") {
 	CHECK(fo.get_bool("bool3", true) == false);
 }
 
+struct on_off_vocabulary : yopt::bool_vocabulary {
+	static constexpr std::string_view true_values[] = {"on", "1"};
+	static constexpr std::string_view false_values[] = {"off", "0"};
+};
+
+TEST_CASE("options bool vocabulary") {
+	static_assert(yopt::detail::bool_recognizer<yopt::bool_vocabulary>::match(std::string_view{"yes"}) == true);
+	static_assert(!yopt::detail::bool_recognizer<yopt::bool_vocabulary>::match(std::wstring_view{L"yes!"}).has_value());
+
+	yopt::options o{L"--a=on --b=off --c=yes --d=TRUE\u00e9"};
+	CHECK(o.get_bool<on_off_vocabulary>("a") == true);
+	CHECK(o.get_bool<on_off_vocabulary>("b", true) == false);
+	CHECK_THROWS_AS(auto discard = o.get_bool<on_off_vocabulary>("c"), std::invalid_argument);
+	CHECK(o.get_bool("c") == true);
+	CHECK_THROWS_AS(auto discard = o.get_bool("d"), std::invalid_argument);
+}
+
+TEST_CASE("options converted values") {
+	yopt::options o{L"--a=42 --b=-7x --c=yes --d=\u0661 --e=12\u00e9 --f"};
+	CHECK(o.get_int("a") == 42);
+	CHECK(o.get_int("b") == -7);
+	CHECK(o.get_int("c").has_value() == false);
+	CHECK(o.get_int("d").has_value() == false);
+	CHECK(o.get_int("e") == 12);
+	CHECK(o.get_int("missing", 3) == 3);
+	CHECK(o.get_bool("c"));
+	CHECK(o.get_bool("f"));
+	CHECK_THROWS_AS(auto discard = o.get_bool("a"), std::invalid_argument);
+}
+
+TEST_CASE("options numbers") {
+	yopt::options o{"--i=-12 --big=9000000000 --max=18446744073709551615 --d=2.5e3 --bad=x"};
+	CHECK(o.get_number<int>("i") == -12);
+	CHECK(o.get_number<int>("big").has_value() == false);
+	CHECK(o.get_number<std::int64_t>("big") == 9000000000);
+	CHECK(o.get_number<std::uint64_t>("max") == 18446744073709551615u);
+	CHECK(o.get_number<std::uint64_t>("i").has_value() == false);
+	CHECK(o.get_number<double>("d") == 2500.0);
+	CHECK(o.get_number<double>("bad").has_value() == false);
+	CHECK(o.get_number<double>("missing", 1.5) == 1.5);
+
+	yopt::options w{L"--big=-9000000000 --d=0.25"};
+	CHECK(w.get_number<std::int64_t>("big") == -9000000000);
+	CHECK(w.get_number<double>("d") == 0.25);
+}
+
 TEST_CASE("options escaping") {
 	yopt::options o{"--t=\"x x\" \"x x x\""};
 	CHECK(o.arg(0) == "x x x");
 	CHECK(o.get_required_native_string("t") == "x x");
 }
 
+TEST_CASE("options repeated") {
+	yopt::options o{"--a=1 --b --a=2 --b=x --b --c= --c"};
+	CHECK(o.get_native_string("a").value() == "2");
+	CHECK(o.get_native_string("b").value() == "x");
+	CHECK(o.has_opt("c"));
+	CHECK(o.get_native_string("c").value() == "");
+	CHECK(o.has_opt("d") == false);
+}
+
+TEST_CASE("options get_all") {
+	yopt::options o{"--include=a --b --include=b --include --x=1 --include=\"c d\" --e="};
+	const auto includes = o.get_all("include");
+	REQUIRE(includes.size() == 3);
+	CHECK(includes[0] == "a");
+	CHECK(includes[1] == "b");
+	CHECK(includes[2] == "c d");
+	CHECK(o.get_native_string("include").value() == "c d");
+	CHECK(o.get_all("b").empty());
+	CHECK(o.has_opt("b"));
+	CHECK(o.get_all("x").size() == 1);
+	CHECK(o.get_all("e").size() == 1);
+	CHECK(o.get_all("missing").empty());
+
+	yopt::options w{L"--in=1 --in=2"};
+	CHECK(w.get_all("in").size() == 2);
+	CHECK(w.get_all("in")[1] == L"2");
+}
+
+TEST_CASE("options get_list") {
+	std::string hosts;
+	for (int i = 0; i < 100; ++i)
+		hosts += (i ? "," : "") + std::string{"host-with-a-long-name-"} + std::to_string(i);
+	const auto cmd = "--hosts=" + hosts + " --ports=80,x,8080 --empty= --flag --edge=,a,";
+	yopt::options<char> o{std::string_view{cmd}};
+	std::vector<std::string_view> pieces;
+	for (const auto h : o.get_list("hosts"))
+		pieces.push_back(h);
+	REQUIRE(pieces.size() == 100);
+	CHECK(pieces[0] == "host-with-a-long-name-0");
+	CHECK(pieces[99] == "host-with-a-long-name-99");
+
+	const auto ports = o.get_list<int>("ports");
+	const std::vector<std::optional<int>> parsed(ports.begin(), ports.end());
+	CHECK(parsed == std::vector<std::optional<int>>{80, std::nullopt, 8080});
+
+	CHECK(o.get_list("empty").empty());
+	CHECK(o.get_list("flag").begin() == o.get_list("flag").end());
+	CHECK(o.get_list("missing").empty());
+	const auto edge = o.get_list("edge");
+	CHECK(std::vector<std::string_view>(edge.begin(), edge.end()) == std::vector<std::string_view>{"", "a", ""});
+
+	yopt::options w{L"--d=1.5;2"};
+	const auto d = w.get_list<double>("d", L';');
+	CHECK(std::vector<std::optional<double>>(d.begin(), d.end()) == std::vector<std::optional<double>>{1.5, 2.0});
+
+	for (size_t n = 0; n < 80; ++n) {
+		const std::string s(n, 'x');
+		CHECK(yopt::detail::find_char(s.data(), s.data() + n, ',') == s.data() + n);
+		for (size_t i = 0; i < n; ++i) {
+			std::string t = s;
+			t[i] = ',';
+			CHECK(yopt::detail::find_char(t.data(), t.data() + n, ',') == t.data() + i);
+		}
+	}
+}
+
+TEST_CASE("options short clusters") {
+	yopt::options o{"-abc -xy=5 --long -q free -"};
+	CHECK(o.has_opt("a"));
+	CHECK(o.has_opt("b"));
+	CHECK(o.has_opt("c"));
+	CHECK(o.has_opt("abc") == false);
+	CHECK(o.has_opt("x"));
+	CHECK(o.get_int("y") == 5);
+	CHECK(o.has_opt("long"));
+	CHECK(o.has_opt("l") == false);
+	CHECK(o.has_opt("q"));
+	CHECK(o.has_opt("z") == false);
+	CHECK(o.arg_count() == 1);
+
+	const char * argv[] = {"prog", "-vk", "-n=3"};
+	const auto b = yopt::parse_batch<char>(std::span<const char * const>{argv + 1, 2}, 1);
+	CHECK(b[0].has_opt("v"));
+	CHECK(b[0].has_opt("k"));
+	CHECK(b[1].get_int("n") == 3);
+
+	yopt::options w{L"-\u00e9f"};
+	CHECK(w.has_opt("f"));
+
+	using cli = yopt::schema<yopt::opt<"v", bool>, yopt::opt<"n", int>, yopt::opt<"o", std::string_view>>;
+	cli s{"-vn 4 -o out.txt input"};
+	CHECK(s.get<"v">() == true);
+	CHECK(s.get<"n">() == 4);
+	CHECK(s.get<"o">() == "out.txt");
+	CHECK(s.arg_count() == 1);
+	const char * sargv[] = {"prog", "-n", "7", "--v=no", "rest"};
+	cli sa{5, sargv};
+	CHECK(sa.get<"n">() == 7);
+	CHECK(sa.get<"v">() == false);
+	CHECK(sa.arg(0) == "rest");
+	CHECK(cli{"-vn=2"}.get<"n">() == 2);
+	CHECK_THROWS_AS(cli{"-n"}, std::invalid_argument);
+	CHECK_THROWS_AS(cli{"-n -v"}, std::invalid_argument);
+}
+
+TEST_CASE("options long number values") {
+	/// wide values are narrowed only as far as from_chars reads, past the 128 char stack buffer too
+	const std::string tail(200, 'x');
+	const std::string zeros(140, '0');
+	const std::string narrow = "--n=5" + tail + " --d=0." + zeros + "1 --z=" + zeros + "42 --bad=" + tail;
+	const std::wstring wide{narrow.begin(), narrow.end()};
+	const yopt::options n{narrow.c_str()};
+	const yopt::options w{wide.c_str()};
+	CHECK(n.get_int("n") == 5);
+	CHECK(n.get_number<double>("d") == 1e-141);
+	CHECK(n.get_number<long>("z") == 42);
+	CHECK(n.get_number<double>("bad").has_value() == false);
+	for (const auto key : {"n", "d", "z", "bad"}) {
+		CHECK(w.get_int(key) == n.get_int(key));
+		CHECK(w.get_number<double>(key) == n.get_number<double>(key));
+		CHECK(w.get_number<long>(key) == n.get_number<long>(key));
+	}
+}
+
+TEST_CASE("options structural scan") {
+	/// vectorized and scalar scanners must agree for every start offset
+	const char alphabet[] = "ab-=\" \t\r\nxyz0";
+	std::uint32_t seed = 12345;
+	std::string s;
+	for (int round = 0; round < 200; ++round) {
+		s.clear();
+		const auto size = round % 97;
+		for (int i = 0; i < size; ++i) {
+			seed = seed * 1664525u + 1013904223u;
+			/// mostly plain chars to get long runs
+			s += (seed >> 24) < 224 ? 'a' + (seed >> 8) % 26 : alphabet[(seed >> 8) % (sizeof(alphabet) - 1)];
+		}
+		const char * const b = s.data();
+		const char * const e = b + s.size() + 1; /// include terminator
+		for (const char * p = b; p < e; ++p) {
+			CHECK(yopt::detail::find_structural(p, e) == yopt::detail::find_structural_scalar(p, e));
+		}
+	}
+}
+
+TEST_CASE("options structural scan tokenize") {
+	/// the block mask of the vectorized scanner must yield the same events as the per char scan
+	struct recorder {
+		std::vector<std::string> events;
+		void on_option(std::string_view key, std::string_view value) {
+			events.push_back("o:" + std::string{key} + (value.data() ? "=" + std::string{value} : ""));
+		}
+		void on_arg(std::string_view value) {
+			events.push_back("a:" + std::string{value});
+		}
+	};
+	const char alphabet[] = "--==\"\" \t\r\n";
+	std::uint32_t seed = 54321;
+	std::string s;
+	for (int round = 0; round < 500; ++round) {
+		s.clear();
+		const auto size = round % 211;
+		for (int i = 0; i < size; ++i) {
+			seed = seed * 1664525u + 1013904223u;
+			/// plain runs of every length around the 16 and 32 byte blocks
+			s += (seed >> 24) < 232 ? 'a' + (seed >> 8) % 26 : alphabet[(seed >> 8) % (sizeof(alphabet) - 1)];
+		}
+		for (const bool single_value : {false, true}) {
+			recorder vector;
+			recorder scalar;
+			yopt::detail::tokenize<true>(s.data(), s.data() + s.size(), single_value, vector);
+			yopt::detail::tokenize<false>(s.data(), s.data() + s.size(), single_value, scalar);
+			CHECK(vector.events == scalar.events);
+		}
+	}
+}
+
+TEST_CASE("options long command line") {
+	std::string cmd;
+	for (int i = 0; i < 50; ++i) {
+		cmd += "--key" + std::to_string(i) + "=value-" + std::to_string(i) + "-with-a-long-tail ";
+		cmd += "\"quoted argument number " + std::to_string(i) + "\" ";
+	}
+	REQUIRE(cmd.size() < yopt::max_length);
+	yopt::options o{cmd.c_str()};
+	CHECK(o.arg_count() == 50);
+	CHECK(o.arg(49) == "quoted argument number 49");
+	CHECK(o.get_native_string("key0").value() == "value-0-with-a-long-tail");
+	CHECK(o.get_native_string("key49").value() == "value-49-with-a-long-tail");
+}
+
+TEST_CASE("options string_view") {
+	std::string cmd;
+	for (int i = 0; i < 1000; ++i) {
+		cmd += "--key" + std::to_string(i) + "=value" + std::to_string(i) + " ";
+	}
+	cmd += "--last=\"x y\" tail --rest-is-not-parsed";
+	REQUIRE(cmd.size() > yopt::max_length);
+	const auto view = std::string_view{cmd}.substr(0, cmd.size() - 21);
+	yopt::options<char> o{view};
+	CHECK(o.get_native_string("key999").value() == "value999");
+	CHECK(o.get_native_string("last").value() == "x y");
+	CHECK(o.arg_count() == 1);
+	CHECK(o.arg(0) == "tail");
+	CHECK(o.has_opt("rest-is-not-parsed") == false);
+
+	const std::string_view argv[] = {"binary", "--t=42 43", "--u", "param--param"};
+	yopt::options<char> ao{4, argv};
+	CHECK(ao.get_native_string("t").value() == "42 43");
+	CHECK(ao.has_opt("u"));
+	CHECK(ao.arg(0) == "param--param");
+}
+
+TEST_CASE("schema") {
+	using cli = yopt::schema<
+		yopt::opt<"threads", int>,
+		yopt::opt<"verbose", bool>,
+		yopt::opt<"ratio", double>,
+		yopt::opt<"name", std::string_view>,
+		yopt::opt<"quiet", bool>
+	>;
+	static_assert(cli::index_of("ratio") == 2);
+	static_assert(cli::index_of("unknown") == cli::size);
+
+	cli o{"--threads=8 --verbose --ratio=0.5 --name=\"a b\" --unknown=1 --verbose=no --verbose input"};
+	CHECK(o.get<"threads">() == 8);
+	CHECK(o.get<"verbose">() == false);
+	CHECK(o.get<"ratio">() == 0.5);
+	CHECK(o.get<"name">() == "a b");
+	CHECK(o.has<"quiet">() == false);
+	CHECK(o.get<"quiet">(true) == true);
+	CHECK(o.arg_count() == 1);
+	CHECK(o.arg(0) == "input");
+
+	CHECK_THROWS_AS(cli{"--threads=many"}, std::invalid_argument);
+
+	yopt::wschema<yopt::opt<"threads", int>> w{L"--threads=16"};
+	CHECK(w.get<"threads">() == 16);
+	CHECK(w.index_of("thread") == w.size);
+}
+
+/// "o000" ... "o599", storage for the names of a large option set
+struct many_names {
+	static constexpr size_t count = 600;
+	static constexpr auto chars = [] {
+		std::array<std::array<char, 4>, count> c{};
+		for (size_t i = 0; i < count; ++i)
+			c[i] = {'o', static_cast<char>('0' + i / 100), static_cast<char>('0' + i / 10 % 10), static_cast<char>('0' + i % 10)};
+		return c;
+	}();
+	static constexpr auto views = [] {
+		std::array<std::string_view, count> v{};
+		for (size_t i = 0; i < count; ++i)
+			v[i] = {chars[i].data(), chars[i].size()};
+		return v;
+	}();
+};
+
+/// opt<"o000", int> ... opt<"o599", int>
+template <size_t I>
+struct generated_name {
+	static constexpr char value[5] = {'o', static_cast<char>('0' + I / 100), static_cast<char>('0' + I / 10 % 10), static_cast<char>('0' + I % 10), 0};
+};
+
+template <typename Seq>
+struct large_schema;
+
+template <size_t... I>
+struct large_schema<std::index_sequence<I...>> {
+	using type = yopt::schema<yopt::opt<generated_name<I>::value, int>...>;
+};
+
+TEST_CASE("schema large") {
+	using cli = large_schema<std::make_index_sequence<many_names::count>>::type;
+	static_assert(cli::size == many_names::count);
+	static_assert(cli::index_of("o599") == 599);
+	static_assert(cli::index_of("o600") == cli::size);
+
+	std::string cmd;
+	for (size_t i = 0; i < cli::size; i += 3)
+		cmd += "--o" + std::string{many_names::views[i].substr(1)} + "=" + std::to_string(i) + " ";
+	cmd += "--unknown=1 tail";
+	const cli o{std::string_view{cmd}};
+	CHECK(o.get<"o000">() == 0);
+	CHECK(o.get<"o297">() == 297);
+	CHECK(o.get<"o597">() == 597);
+	CHECK(o.has<"o598">() == false);
+	CHECK(o.arg_count() == 1);
+}
+
+TEST_CASE("schema perfect hash") {
+	static constexpr yopt::detail::perfect_hash<wchar_t, many_names::count> hash{many_names::views};
+	std::array<bool, many_names::count> seen{};
+	for (size_t i = 0; i < many_names::count; ++i) {
+		const std::wstring wide{many_names::views[i].begin(), many_names::views[i].end()};
+		CHECK(hash.candidate(many_names::views[i]) == i);
+		CHECK(hash.candidate(std::wstring_view{wide}) == i);
+		seen[hash.candidate(many_names::views[i])] = true;
+	}
+	CHECK(std::all_of(seen.begin(), seen.end(), [](bool b) { return b; }));
+	CHECK(hash.candidate(std::string_view{"unknown"}) < many_names::count);
+}
+
+TEST_CASE("options pmr") {
+	/// the arena has no upstream, any allocation beyond the stack buffer throws
+	std::byte buffer[4096];
+	std::pmr::monotonic_buffer_resource arena{buffer, sizeof(buffer), std::pmr::null_memory_resource()};
+	const char * argv[] = {"binary", "--b=2", "--a=1", "--b=3", "--flag", "free"};
+	yopt::pmr::options<char> o{6, argv, &arena};
+	CHECK(o.get_int("b") == 3);
+	CHECK(o.get_int("a") == 1);
+	CHECK(o.get_bool("flag"));
+	CHECK(o.args().size() == 1);
+	CHECK(o.get_allocator().resource() == &arena);
+
+	std::byte small[16];
+	std::pmr::monotonic_buffer_resource tiny{small, sizeof(small), std::pmr::null_memory_resource()};
+	CHECK_THROWS_AS(yopt::pmr::options<char>(6, argv, &tiny), std::bad_alloc);
+}
+
+TEST_CASE("options response file") {
+	const auto dir = std::filesystem::temp_directory_path();
+	const auto outer = (dir / "yopt_test_outer.rsp").string();
+	const auto inner = (dir / "yopt_test_inner.rsp").string();
+	const auto loop = (dir / "yopt_test_loop.rsp").string();
+	std::ofstream{outer} << "--a=1 \"quoted arg\"\n--shared=outer @" << inner << " --last";
+	std::ofstream{inner} << "--b=2 --shared=inner";
+	std::ofstream{loop} << "@" << loop;
+
+	const std::string outer_arg = "@" + outer;
+	const char * argv[] = {"binary", outer_arg.c_str(), "--c", "@/nonexistent/yopt.rsp"};
+	yopt::options o{4, argv};
+	CHECK(o.get_int("a") == 1);
+	CHECK(o.get_int("b") == 2);
+	CHECK(o.get_native_string("shared").value() == "inner");
+	CHECK(o.has_opt("last"));
+	CHECK(o.has_opt("c"));
+	CHECK(o.arg_count() == 2);
+	CHECK(o.arg(0) == "quoted arg");
+	CHECK(o.arg(1) == "@/nonexistent/yopt.rsp");
+
+	const yopt::options copy = o;
+	CHECK(copy.get_native_string("a").value() == "1");
+
+	const std::string loop_arg = "@" + loop;
+	const char * loop_argv[] = {"binary", loop_arg.c_str()};
+	CHECK_THROWS_AS(yopt::options(2, loop_argv), std::runtime_error);
+
+	std::filesystem::remove(outer);
+	std::filesystem::remove(inner);
+	std::filesystem::remove(loop);
+}
+
+TEST_CASE("options wide response file") {
+	const auto dir = std::filesystem::temp_directory_path();
+	const auto utf8 = dir / "yopt_test_utf8.rsp";
+	const auto invalid = dir / "yopt_test_invalid.rsp";
+	std::ofstream{utf8, std::ios::binary} << "\xEF\xBB\xBF--alpha=1 beta --name=\xC3\xA9t\xC3\xA9 \xF0\x9F\x98\x80";
+	std::ofstream{invalid, std::ios::binary} << "--alpha=\xC3(";
+
+	const std::wstring utf8_arg = L"@" + utf8.wstring();
+	const wchar_t * argv[] = {L"binary", utf8_arg.c_str()};
+	std::optional<yopt::options<wchar_t>> o{std::in_place, 2, argv};
+	CHECK(o->get_int("alpha") == 1);
+	CHECK(o->get_native_string("name").value() == L"\u00E9t\u00E9");
+	REQUIRE(o->arg_count() == 2);
+	CHECK(o->arg(0) == L"beta");
+	CHECK(o->arg(1) == L"\U0001F600");
+	/// the transcoded buffer is shared with copies
+	const yopt::options<wchar_t> copy = *o;
+	o.reset();
+	CHECK(copy.get_native_string("name").value() == L"\u00E9t\u00E9");
+
+	/// char options view the same file in place, after the byte order mark
+	const std::string narrow_arg = "@" + utf8.string();
+	const char * narrow_argv[] = {"binary", narrow_arg.c_str()};
+	const yopt::options narrow{2, narrow_argv};
+	CHECK(narrow.get_int("alpha") == 1);
+	CHECK(narrow.get_native_string("name").value() == "\xC3\xA9t\xC3\xA9");
+
+	const std::wstring invalid_arg = L"@" + invalid.wstring();
+	const wchar_t * invalid_argv[] = {L"binary", invalid_arg.c_str()};
+	CHECK_THROWS_AS(yopt::options<wchar_t>(2, invalid_argv), std::runtime_error);
+
+	std::filesystem::remove(utf8);
+	std::filesystem::remove(invalid);
+}
+
+TEST_CASE("parse_batch") {
+	std::vector<std::string> storage;
+	for (int i = 0; i < 100; ++i) {
+		storage.push_back("--id=" + std::to_string(i) + " --flag --id=" + std::to_string(i * 2) + " job" + std::to_string(i));
+	}
+	storage.push_back("");
+	std::vector<const char *> lines;
+	for (const auto & l : storage) {
+		lines.push_back(l.c_str());
+	}
+	for (const unsigned threads : {1u, 3u, 8u}) {
+		const auto b = yopt::parse_batch<char>(lines, threads);
+		REQUIRE(b.size() == lines.size());
+		for (int i = 0; i < 100; ++i) {
+			CHECK(b[i].get_int("id") == i * 2);
+			CHECK(b[i].get_bool("flag"));
+			CHECK(b[i].arg_count() == 1);
+			CHECK(b[i].arg(0) == "job" + std::to_string(i));
+			REQUIRE(b[i].get_all("id").size() == 2);
+			CHECK(b[i].get_all("id")[0] == std::to_string(i));
+			CHECK(b[i].get_all("flag").empty());
+		}
+		CHECK(b[100].has_opt("id") == false);
+		CHECK(b[100].arg_count() == 0);
+	}
+	CHECK(yopt::parse_batch<char>({}, 4).size() == 0);
+}
+
+TEST_CASE("parse visitor") {
+	struct counter {
+		int options = 0;
+		int args = 0;
+		bool verbose = false;
+		std::string_view level;
+
+		void on_option(std::string_view key, std::string_view value) {
+			++options;
+			if (key == "v")
+				verbose = true;
+			else if (key == "level")
+				level = value;
+		}
+		void on_arg(std::string_view) {
+			++args;
+		}
+	};
+
+	counter c;
+	yopt::parse("prog -v --level=3 file1 \"file 2\" --x", c);
+	CHECK(c.options == 3);
+	CHECK(c.args == 3);
+	CHECK(c.verbose);
+	CHECK(c.level == "3");
+
+	const char * argv[] = {"prog", "--name=a b", "@rsp", "-q"};
+	counter a;
+	yopt::parse(4, argv, a);
+	CHECK(a.options == 2);
+	CHECK(a.args == 1);
+
+	counter w;
+	yopt::parse(std::string_view{"--level=9"}, w);
+	CHECK(w.level == "9");
+}
+
+TEST_CASE("stream parser") {
+	struct recorder {
+		std::vector<std::string> events;
+		void on_option(std::string_view key, std::string_view value) {
+			events.push_back(std::string{key} + (value.data() ? "=" + std::string{value} : ""));
+		}
+		void on_arg(std::string_view value) {
+			events.push_back("'" + std::string{value} + "'");
+		}
+	};
+	const std::string_view cmd = R"(prog -o --long=value --q="a b" -f "free arg" --e= -xyz=1 last)";
+	const std::vector<std::string> expected{"'prog'", "o", "long=value", "q=a b", "f", "'free arg'", "e=", "x", "y", "z=1", "'last'"};
+
+	recorder whole;
+	yopt::basic_stream_parser<char, recorder &> p{whole};
+	p.feed(cmd);
+	p.finish();
+	CHECK(whole.events == expected);
+
+	for (size_t i = 0; i <= cmd.size(); ++i) {
+		for (size_t j = i; j <= cmd.size(); ++j) {
+			yopt::basic_stream_parser<char, recorder> sp{recorder{}};
+			sp.feed(cmd.substr(0, i));
+			sp.feed(cmd.substr(i, j - i));
+			sp.feed(cmd.substr(j));
+			sp.finish();
+			CHECK(sp.visitor().events == expected);
+		}
+	}
+
+	yopt::basic_stream_parser<char, recorder> sp{recorder{}};
+	for (const char c : std::string_view{"--key=value -x"})
+		sp.feed({&c, 1});
+	sp.finish();
+	CHECK(sp.visitor().events == std::vector<std::string>{"key=value", "x"});
+}
+
+#if defined __linux__
+TEST_CASE("options from_process") {
+	const auto & o = yopt::options<char>::from_process();
+	CHECK(&o == &yopt::options<char>::from_process());
+
+	const char cmdline[] = "prog\0--t=a b\0-v\0\0free\0";
+	const auto argv = yopt::detail::split_nul({cmdline, sizeof(cmdline) - 1});
+	CHECK(argv.size() == 5);
+	yopt::options<char> p{static_cast<int>(argv.size()), argv.data()};
+	CHECK(p.get_native_string("t").value() == "a b");
+	CHECK(p.has_opt("v"));
+	CHECK(p.arg_count() == 1);
+	CHECK(p.arg(0) == "free");
+}
+#endif
+
+TEST_CASE("environment") {
+	const char * envp[] = {"MYAPP_THREADS=8", "MYAPP_MAX_JOBS=3", "MYAPP_VERBOSE=yes", "MYAPP_=x", "MYAPP_Q", "OTHER_THREADS=1",
+		"MYAPP_EMPTY=", "MYAPP_V=a=b", nullptr};
+	yopt::environment e{envp, "MYAPP_"};
+	CHECK(e.get_int("threads") == 8);
+	CHECK(e.get_int("max-jobs") == 3);
+	CHECK(e.get_bool("verbose"));
+	CHECK(e.has_opt("empty"));
+	CHECK(e.get_native_string("empty").value() == "");
+	CHECK(e.has_opt("v"));
+	CHECK(e.get_native_string("v").value() == "a=b");
+	CHECK(e.has_opt("q") == false);
+	CHECK(e.has_opt("") == false);
+	CHECK(e.arg_count() == 0);
+
+	yopt::environment raw{envp, {}, false};
+	CHECK(raw.get_int("OTHER_THREADS") == 1);
+	CHECK(raw.has_opt("other_threads") == false);
+
+	std::string changing = "YOPT_TEST_LEVEL=2";
+	const char * live[] = {changing.c_str(), nullptr};
+	yopt::environment snapshot{live, "YOPT_TEST_"};
+	changing.assign("YOPT_TEST_LEVEL=9");
+	CHECK(snapshot.get_int("level") == 2);
+	const auto moved = std::move(snapshot);
+	CHECK(moved.get_int("level") == 2);
+
+#if !defined _WIN32
+	::setenv("YOPT_TEST_RATIO", "0.5", 1);
+	const yopt::environment process{"YOPT_TEST_"};
+	CHECK(process.get_number<double>("ratio") == 0.5);
+	::unsetenv("YOPT_TEST_RATIO");
+	CHECK(process.get_number<double>("ratio") == 0.5);
+#endif
+}
+
+TEST_CASE("layered") {
+	const char * argv[] = {"prog", "--threads=16", "--include=cli", "input"};
+	const yopt::options cli{4, argv};
+	const char * envp[] = {"MYAPP_THREADS=8", "MYAPP_LOG_LEVEL=debug", "MYAPP_INCLUDE=env", nullptr};
+	const yopt::environment env{envp, "MYAPP_"};
+	const yopt::options file{"--log-level=info --cache=/tmp --include=a --include=b"};
+	const yopt::options defaults{"--threads=4 --verbose=no --cache=/var/cache"};
+
+	const yopt::layered config{cli, env, file, defaults};
+	CHECK(config.get_int("threads") == 16);
+	CHECK(config.layer_of("threads") == 0);
+	CHECK(config.get_native_string("log-level").value() == "debug");
+	CHECK(config.layer_of("log-level") == 1);
+	CHECK(config.get_native_string("cache").value() == "/tmp");
+	CHECK(config.layer_of("cache") == 2);
+	CHECK(config.get_bool("verbose", true) == false);
+	CHECK(config.layer_of("verbose") == 3);
+	CHECK(config.layer_of("missing").has_value() == false);
+	CHECK(config.get_all("include").size() == 1);
+	CHECK(config.arg_count() == 1);
+	CHECK(config.arg(0) == "input");
+	/// values are views into the winning source
+	CHECK(config.get_native_string("cache")->data() == file.get_native_string("cache")->data());
+
+	const yopt::layered without_cli{file, config};
+	CHECK(without_cli.get_all("include").size() == 2);
+	CHECK(without_cli.layer_of("threads") == 1);
+	CHECK(without_cli.arg_count() == 0);
+}
+
+TEST_CASE("snapshot") {
+	const char * argv[] = {"prog", "--threads=8", "--verbose", "--ratio=0.25", "--in=a", "--in=b", "-x", "--name=caf\xC3\xA9", "free arg", "--hosts=h1,h2"};
+	const yopt::options o{10, argv};
+	const auto image = yopt::serialize(o);
+
+	/// relocated: read from a copy at another address
+	const std::vector<std::byte> moved{image.begin(), image.end()};
+	for (const auto * bytes : {&image, &moved}) {
+		const yopt::snapshot_view s{*bytes};
+		CHECK(s.get_int("threads") == 8);
+		CHECK(s.get_bool("verbose"));
+		CHECK(s.get_native_string("verbose").value().data() == nullptr);
+		CHECK(s.get_number<double>("ratio") == 0.25);
+		CHECK(s.get_native_string("in").value() == "b");
+		CHECK(s.value_count("in") == 2);
+		CHECK(s.get_value("in", 0) == "a");
+		CHECK(s.has_opt("x"));
+		CHECK(s.has_opt("y") == false);
+		CHECK(s.has_opt("missing") == false);
+		CHECK(s.get_string("name").value() == "caf\xC3\xA9");
+		CHECK(std::distance(s.get_list("hosts").begin(), s.get_list("hosts").end()) == 2);
+		CHECK(s.arg_count() == 1);
+		CHECK(s.arg(0) == "free arg");
+		CHECK_THROWS_AS(auto discard = s.get_bool("threads"), std::invalid_argument);
+	}
+
+	CHECK_THROWS_AS(yopt::wsnapshot_view{image}, std::invalid_argument);
+	CHECK_THROWS_AS(yopt::snapshot_view{std::span{image}.first(image.size() - 1)}, std::invalid_argument);
+
+	/// corrupt offsets and ranges of the right total size are rejected
+	const auto corrupt = [&](size_t at, std::uint32_t value) {
+		auto bad = image;
+		std::memcpy(bad.data() + at, &value, sizeof(value));
+		return bad;
+	};
+	const auto keys_at = sizeof(yopt::detail::snapshot_header);
+	const auto key_size = sizeof(yopt::detail::snapshot_key);
+	CHECK_THROWS_AS(yopt::snapshot_view{corrupt(keys_at + offsetof(yopt::detail::snapshot_key, key), 0x7FFFFFFF)}, std::invalid_argument);
+	CHECK_THROWS_AS(yopt::snapshot_view{corrupt(keys_at + offsetof(yopt::detail::snapshot_key, key), yopt::detail::snapshot_string::null_offset)}, std::invalid_argument);
+	CHECK_THROWS_AS(yopt::snapshot_view{corrupt(keys_at + key_size + offsetof(yopt::detail::snapshot_key, value) + 4, 1000000)}, std::invalid_argument);
+	CHECK_THROWS_AS(yopt::snapshot_view{corrupt(keys_at + offsetof(yopt::detail::snapshot_key, values_count), 100)}, std::invalid_argument);
+	yopt::detail::snapshot_header h;
+	std::memcpy(&h, image.data(), sizeof(h));
+	const auto args_at = keys_at + h.key_count * key_size;
+	CHECK_THROWS_AS(yopt::snapshot_view{corrupt(args_at, 0xFFFFFFF0)}, std::invalid_argument);
+
+	/// each value is pooled once, the key value shares the string of its last repeated value
+	const std::string long_value(1000, 'v');
+	const std::string big_line = "--a=" + long_value + " --b --c=1 --c=23";
+	const yopt::options big{big_line.c_str()};
+	const auto big_image = yopt::serialize(big);
+	std::memcpy(&h, big_image.data(), sizeof(h));
+	CHECK(h.pool_size == 1 + long_value.size() + 1 + 1 + 1 + 2);
+	const yopt::snapshot_view bs{big_image};
+	CHECK(bs.get_native_string("a").value() == long_value);
+	CHECK(bs.get_native_string("b").value().data() == nullptr);
+	CHECK(bs.get_int("c") == 23);
+	CHECK(bs.get_value("c", 0) == "1");
+
+	const yopt::options w{L"--level=3 --flag"};
+	const auto wimage = yopt::serialize(w);
+	const yopt::wsnapshot_view ws{wimage};
+	CHECK(ws.get_int("level") == 3);
+	CHECK(ws.get_native_string("level").value() == L"3");
+	CHECK(ws.has_opt("flag"));
+
+	const auto path = (std::filesystem::temp_directory_path() / "yopt_test.snapshot").string();
+	std::ofstream{path, std::ios::binary}.write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+	const yopt::snapshot_view mapped{path.c_str()};
+	CHECK(mapped.get_int("threads") == 8);
+	CHECK(mapped.get_value("in", 1) == "b");
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("options copy_input") {
+	std::optional<yopt::options<char>> o;
+	{
+		std::string temporary = "--name=\"a b\" --in=1 --in=2 -v --e= free";
+		o.emplace(yopt::copy_input, temporary);
+		temporary.assign(temporary.size(), 'x');
+	}
+	CHECK(o->get_native_string("name").value() == "a b");
+	CHECK(o->get_all("in").size() == 2);
+	CHECK(o->get_all("in")[1] == "2");
+	CHECK(o->has_opt("v"));
+	CHECK(o->get_native_string("e").value() == "");
+	CHECK(o->arg(0) == "free");
+
+	auto copy = std::make_unique<yopt::options<char>>(*o);
+	o.reset();
+	CHECK(copy->get_native_string("name").value() == "a b");
+	const auto moved = std::move(*copy);
+	copy.reset();
+	CHECK(moved.get_all("in")[0] == "1");
+	CHECK(moved.arg(0) == "free");
+
+	std::vector<std::string> args{"prog", "--t=42 43", "-q", "x y"};
+	const char * argv[] = {args[0].c_str(), args[1].c_str(), args[2].c_str(), args[3].c_str()};
+	yopt::options<char> ao{yopt::copy_input, 4, argv};
+	args.clear();
+	CHECK(ao.get_native_string("t").value() == "42 43");
+	CHECK(ao.has_opt("q"));
+	CHECK(ao.arg(0) == "x y");
+
+	/// assignment between arenas copies the elements, the views follow the buffer
+	std::pmr::monotonic_buffer_resource first;
+	std::pmr::monotonic_buffer_resource second;
+	yopt::pmr::options<char> p{yopt::copy_input, std::string_view{"--k=v"}, &first};
+	yopt::pmr::options<char> q{yopt::copy_input, std::string_view{"--other=1"}, &second};
+	q = std::move(p);
+	p = q;
+	CHECK(q.get_native_string("k").value() == "v");
+	CHECK(p.get_native_string("k").value() == "v");
+	CHECK(q.get_native_string("k")->data() != p.get_native_string("k")->data());
+}
+
+TEST_CASE("command builder") {
+	const char * parent_argv[] = {"parent", "--threads=8", "--in=a", "--in=b c", "-v", "--drop=1", "--e=", "free arg", "\"-dash\"", "\"@at\"", "plain"};
+	const yopt::options parent{11, parent_argv};
+	yopt::command_builder b{parent};
+	b.set("threads", "16").remove("drop").set("name", "a\"b").set_flag("new-flag").remove("missing");
+
+	const auto check = [](const auto & o) {
+		CHECK(o.get_int("threads") == 16);
+		CHECK(o.get_all("in").size() == 2);
+		CHECK(o.get_all("in")[1] == "b c");
+		CHECK(o.has_opt("v"));
+		CHECK(o.has_opt("drop") == false);
+		CHECK(o.has_opt("missing") == false);
+		CHECK(o.get_native_string("e").value() == "");
+		CHECK(o.has_opt("new-flag"));
+		CHECK(o.arg_count() == 4);
+		CHECK(o.arg(0) == "free arg");
+		CHECK(o.arg(1) == "-dash");
+		CHECK(o.arg(2) == "@at");
+		CHECK(o.arg(3) == "plain");
+	};
+
+	const auto argv = b.argv("child");
+	REQUIRE(argv.size() == 12);
+	CHECK(argv.data()[argv.size()] == nullptr);
+	CHECK(std::string_view{argv[0]} == "child");
+	const auto block_begin = reinterpret_cast<const char *>(argv.data());
+	for (size_t i = 0; i < argv.size(); ++i)
+		CHECK(argv[i] > block_begin);
+	const yopt::options child{static_cast<int>(argv.size()), argv.data()};
+	check(child);
+	CHECK(child.get_native_string("name").value() == "a\"b");
+
+	yopt::command_builder line_builder{parent};
+	line_builder.set("threads", "16").remove("drop").set_flag("new-flag");
+	const auto line = line_builder.command_line();
+	CHECK(line.capacity() - line.size() < 16);
+	const yopt::options reparsed{line.c_str()};
+	check(reparsed);
+	CHECK(yopt::options{b.command_line().c_str()}.get_native_string("name").value() == "a\"b");
+	b.set("name", "\"quoted");
+	CHECK_THROWS_AS(auto discard = b.command_line(), std::invalid_argument);
+	b.set("name", "a \"b\"");
+	CHECK_THROWS_AS(auto discard = b.command_line(), std::invalid_argument);
+	CHECK_NOTHROW(auto discard = b.argv("child"));
+
+	const yopt::options w{L"--k=\"v w\" x"};
+	const auto wline = yopt::wcommand_builder{w}.command_line();
+	CHECK(wline == L"--k=\"v w\" x");
+}
+
 TEST_CASE("options argv") {
 	constexpr int argc = 5;
 	const char * argv[argc] = {